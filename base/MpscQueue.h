@@ -0,0 +1,114 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <atomic>
+#include <assert.h>
+#include <stddef.h>
+
+namespace muduo
+{
+
+// Intrusive lock-free queue for many producers and one consumer,
+// after Dmitry Vyukov's intrusive MPSC node-based queue.
+//
+// Node must be default constructible and have a member
+//   std::atomic<Node*> next;
+// The queue never allocates, nodes are owned by the caller between pop()
+// and the next push(), and may be reused as soon as pop() returns them.
+// push() is wait-free, one atomic exchange per node, no mutex.
+// pop() may return NULL while a producer is half way through push(),
+// the node shows up on a later pop().
+//
+// 多生产者单消费者无锁队列，节点由调用者分配和释放
+template<typename Node>
+class MpscQueue : noncopyable
+{
+ public:
+  MpscQueue()
+    : head_(&stub_),
+      tail_(&stub_)
+  {
+    stub_.next.store(NULL, std::memory_order_relaxed);
+  }
+
+  ~MpscQueue()
+  {
+    assert(empty());
+  }
+
+  // Thread safe.
+  void push(Node* node)
+  {
+    node->next.store(NULL, std::memory_order_relaxed);
+    // 先抢占队尾，再把前一个节点链接过来
+    // seq_cst: 消费者先置睡眠标志再检查empty()，生产者先push再检查睡眠标志
+    Node* prev = head_.exchange(node, std::memory_order_seq_cst);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Consumer only. The caller owns the returned node.
+  Node* pop()
+  {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+      if (next == NULL)
+      {
+        return NULL;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire))
+    {
+      // 生产者还没有链接好
+      return NULL;
+    }
+    // tail是最后一个节点，放入stub以便取出它
+    push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+    return NULL;
+  }
+
+  // The last node pushed, the consumer may stop popping after it.
+  // May be the internal stub, never returned by pop().
+  // Thread safe.
+  const Node* back() const
+  {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  // Consumer only. False while a push() is in progress.
+  // head_ alone is not enough, pop() re-pushes the stub behind
+  // nodes which are not linked yet.
+  bool empty() const
+  {
+    return tail_ == &stub_ && head_.load(std::memory_order_seq_cst) == &stub_;
+  }
+
+ private:
+  Node stub_;
+  std::atomic<Node*> head_;  // 生产者在这里push
+  Node* tail_;               // 消费者在这里pop
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_MPSCQUEUE_H
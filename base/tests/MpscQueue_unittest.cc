@@ -0,0 +1,87 @@
+#include "muduo/base/MpscQueue.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+
+#include <memory>
+#include <vector>
+#include <assert.h>
+#include <stdio.h>
+
+struct Node
+{
+  std::atomic<Node*> next;
+  int producer;
+  int seq;
+};
+
+const int kProducers = 4;
+const int kNodesPerProducer = 200 * 1000;
+
+muduo::MpscQueue<Node> g_queue;
+muduo::CountDownLatch g_start(1);
+
+void produce(int producer)
+{
+  g_start.wait();
+  for (int i = 0; i < kNodesPerProducer; ++i)
+  {
+    Node* node = new Node;
+    node->producer = producer;
+    node->seq = i;
+    g_queue.push(node);
+  }
+}
+
+int main()
+{
+  {
+  // single thread
+  muduo::MpscQueue<Node> queue;
+  assert(queue.empty());
+  assert(queue.pop() == NULL);
+  Node a, b;
+  queue.push(&a);
+  assert(!queue.empty());
+  assert(queue.back() == &a);
+  queue.push(&b);
+  assert(queue.back() == &b);
+  assert(queue.pop() == &a);
+  assert(!queue.empty());
+  assert(queue.pop() == &b);
+  assert(queue.empty());
+  assert(queue.pop() == NULL);
+  queue.push(&a);
+  assert(queue.pop() == &a);
+  assert(queue.empty());
+  }
+
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < kProducers; ++i)
+  {
+    threads.emplace_back(new muduo::Thread(std::bind(produce, i)));
+    threads.back()->start();
+  }
+  g_start.countDown();
+
+  // 每个生产者的节点保持先进先出
+  std::vector<int> next(kProducers, 0);
+  int total = 0;
+  while (total < kProducers * kNodesPerProducer)
+  {
+    Node* node = g_queue.pop();
+    if (node)
+    {
+      assert(node->seq == next[node->producer]);
+      ++next[node->producer];
+      ++total;
+      delete node;
+    }
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  assert(g_queue.pop() == NULL);
+  assert(g_queue.empty());
+  printf("%d nodes from %d producers\n", total, kProducers);
+}
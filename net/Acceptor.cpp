@@ -26,6 +26,7 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
 	: loop_(loop),
 	acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),//创建了套接字
 	acceptChannel_(loop, acceptSocket_.fd()),//关注套接字的事件
+	acceptBudget_(1),
 	listenning_(false),//在创建accept的时候是不监听的，只有当调用listen的时候才开始监听
 	idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))//预先准备一个文件描述符，空闲的文件描述符
 {
@@ -40,11 +41,32 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
 		std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop* loop, int listenfd)
+	: loop_(loop),
+	acceptSocket_(::fcntl(listenfd, F_DUPFD_CLOEXEC, 0)),	// 非阻塞标志是共享的
+	acceptChannel_(loop, acceptSocket_.fd()),
+	acceptBudget_(1),
+	listenning_(false),
+	idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+{
+	if (acceptSocket_.fd() < 0)
+	{
+		LOG_SYSFATAL << "Acceptor::Acceptor dup";
+	}
+	assert(idleFd_ >= 0);
+	acceptChannel_.setExclusive(true);
+	acceptChannel_.setReadCallback(
+		std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
 	//处理掉所有的事件，才能结束
-	acceptChannel_.disableAll();
-	acceptChannel_.remove();//处理掉该通道
+	if (listenning_)	// 没有listen()过的通道不在Poller中
+	{
+		acceptChannel_.disableAll();
+		acceptChannel_.remove();//处理掉该通道
+	}
 	::close(idleFd_);//关闭文件描述符
 }
 
@@ -52,7 +74,7 @@ void Acceptor::listen()
 {
 	loop_->assertInLoopThread();
 	listenning_ = true;//设置监听标志位=true
-	acceptSocket_.listen();//开启监听
+	acceptSocket_.listen();//开启监听，共用的socket再listen一次也没有关系
 	acceptChannel_.enableReading();//关注它的可读事件
 }
 
@@ -60,42 +82,56 @@ void Acceptor::listen()
 void Acceptor::handleRead()
 {
 	loop_->assertInLoopThread();
-	InetAddress peerAddr;
-	//FIXME loop until no more
-	//接受连接
-	int connfd = acceptSocket_.accept(&peerAddr);
-	if (connfd >= 0)
+	// 大量连接同时到来时一次唤醒accept多个，剩下的留给下一次poll，不饿死其他通道
+	int accepted = 0;
+	while (accepted < acceptBudget_)
 	{
-		// string hostport = peerAddr.toIpPort();
-		// LOG_TRACE << "Accepts of " << hostport;
-
-		  //回调上层应用函数
-		if (newConnectionCallback_)
+		InetAddress peerAddr;
+		//接受连接
+		int connfd = acceptSocket_.accept(&peerAddr);
+		if (connfd >= 0)
 		{
-			newConnectionCallback_(connfd, peerAddr);
+			// string hostport = peerAddr.toIpPort();
+			// LOG_TRACE << "Accepts of " << hostport;
+			++accepted;
+
+			  //回调上层应用函数
+			if (newConnectionCallback_)
+			{
+				newConnectionCallback_(connfd, peerAddr);
+			}
+			else
+			{
+				//如果上层应用程序没有设置回调函数，则把该connfd socket关闭
+				sockets::close(connfd);
+			}
 		}
 		else
 		{
-			//如果上层应用程序没有设置回调函数，则把该connfd socket关闭
-			sockets::close(connfd);
+			const int savedErrno = errno;
+			if (savedErrno != EAGAIN)	// 没有更多连接了，共用监听socket时也可能被别的线程先accept了
+			{
+				LOG_SYSERR << "in Acceptor::handleRead";
+				// Read the section named "The special problem of
+				// accept()ing when you can't" in libev's doc.
+				// By Marc Lehmann, author of libev.
+
+				//如果失败了，可能的错误是文件描述符不够了
+				if (savedErrno == EMFILE)
+				{
+					//因为我们使用epoll的模式是电平触发，如果我们不处理就会一直触发该事件
+					::close(idleFd_);
+					idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+					::close(idleFd_);
+					idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+				}
+			}
+			break;
 		}
 	}
-	else
+	if (accepted > 0 && batchEndCallback_)
 	{
-		LOG_SYSERR << "in Acceptor::handleRead";
-		// Read the section named "The special problem of
-		// accept()ing when you can't" in libev's doc.
-		// By Marc Lehmann, author of libev.
-
-		//如果失败了，可能的错误是文件描述符不够了
-		if (errno == EMFILE)
-		{
-			//因为我们使用epoll的模式是电平触发，如果我们不处理就会一直触发该事件
-			::close(idleFd_);
-			idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-			::close(idleFd_);
-			idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
-		}
+		batchEndCallback_();
 	}
 }
 
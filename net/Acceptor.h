@@ -31,8 +31,13 @@ namespace muduo
 		{
 		public:
 			typedef std::function<void(int sockfd, const InetAddress&)> NewConnectionCallback;
+			typedef std::function<void()> BatchEndCallback;
 
 			Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
+			/// Accepts from the socket of another Acceptor in loop, with
+			/// EPOLLEXCLUSIVE. listenfd is dup()ed.
+			// 多个IO线程共用一个监听socket
+			Acceptor(EventLoop* loop, int listenfd);
 			~Acceptor();
 
 			void setNewConnectionCallback(const NewConnectionCallback& cb)
@@ -40,8 +45,19 @@ namespace muduo
 				newConnectionCallback_ = cb;
 			}
 
+			/// Accepts up to budget connections per readable event, until there
+			/// is no more, 1 by default.
+			void setAcceptBudget(int budget) { acceptBudget_ = budget; }
+			/// Called after the connections accepted for one readable event have
+			/// all been passed to the NewConnectionCallback, if there was any.
+			void setBatchEndCallback(const BatchEndCallback& cb)
+			{
+				batchEndCallback_ = cb;
+			}
+
 			bool listenning() const { return listenning_; }
 			void listen();
+			int fd() const { return acceptSocket_.fd(); }
 
 		private:
 			void handleRead();
@@ -50,6 +66,8 @@ namespace muduo
 			Socket acceptSocket_;//accepte套接字，即监听套接字
 			Channel acceptChannel_;//管道
 			NewConnectionCallback newConnectionCallback_;
+			BatchEndCallback batchEndCallback_;
+			int acceptBudget_;	// 每次可读事件最多accept的连接数
 			bool listenning_;//是否处于监听的状态
 			int idleFd_;
 		};
@@ -1,5 +1,6 @@
 #include "muduo/net/Buffer.h"
 
+#include "muduo/net/BufferSearch.h"
 #include "muduo/net/SocketsOps.h"
 #include "Buffer.h"
 #include "SocketsOps.h"
@@ -10,12 +11,23 @@
 using namespace muduo;
 using namespace muduo::net;
 
-// 初始化/r/n
-const char Buffer::kCRLF[] = "\r\n";
-
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
 
+const char* Buffer::findCRLF(const char* start) const
+{
+	assert(peek() <= start);
+	assert(start <= beginWrite());
+	return detail::findCRLF(start, beginWrite());
+}
+
+const char* Buffer::findAnyOf(const char* start, const StringPiece& delims) const
+{
+	assert(peek() <= start);
+	assert(start <= beginWrite());
+	return detail::findAnyOf(start, beginWrite(), delims.data(), delims.size());
+}
+
 // 结合詹上的空间，避免内存使用过大，提高内存使用率
 // 如果有10K个连接，每个连接就分配64K的缓冲区，将占用640M内存
 // 而大多数时候，这些缓冲区的使用率很低
@@ -56,3 +68,18 @@ ssize_t Buffer::readFd(int fd, int* savedErrno)
 	return n;
 }
 
+ssize_t Buffer::readFd(int fd, size_t len, int* savedErrno)
+{
+	ensureWritableBytes(len);
+	const ssize_t n = sockets::read(fd, beginWrite(), len);
+	if (n < 0)
+	{
+		*savedErrno = errno;
+	}
+	else
+	{
+		hasWritten(n);
+	}
+	return n;
+}
+
@@ -39,6 +39,9 @@ namespace muduo
 		/// |                   |                  |                  |
 		/// 0      <=      readerIndex   <=   writerIndex    <=     size
 		/// @endcode
+		///
+		/// A Buffer whose storage was given back to a BufferPool has no storage
+		/// at all, it allocates again on the next append.
 		class Buffer : public muduo::copyable
 		{
 		public:
@@ -95,22 +98,24 @@ namespace muduo
 			// 查找\R\N
 			const char* findCRLF() const
 			{
-				// FIXME: replace with memmem()?
-				// 查找KCRLF字符串
-				const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-				return crlf == beginWrite() ? NULL : crlf;
+				return findCRLF(peek());
 			}
 
 			// 从start的位置开始查找\r\n
-			const char* findCRLF(const char* start) const
+			// SIMD kernels (AVX2/SSE2) are selected at runtime, see detail::findCRLF()
+			const char* findCRLF(const char* start) const;
+
+			/// Finds the first byte which is any of delims, e.g. " \r\n".
+			/// @return NULL if not found
+			// 查找delims中任意一个字符第一次出现的位置
+			const char* findAnyOf(const StringPiece& delims) const
 			{
-				assert(peek() <= start);
-				assert(start <= beginWrite());
-				// FIXME: replace with memmem()?
-				const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF + 2);
-				return crlf == beginWrite() ? NULL : crlf;
+				return findAnyOf(peek(), delims);
 			}
 
+			const char* findAnyOf(const char* start, const StringPiece& delims) const;
+
+			// memchr() in glibc is already vectorized, there is no need for our own kernel
 			const char* findEOL() const
 			{
 				const void* eol = memchr(peek(), '\n', readableBytes());
@@ -181,8 +186,11 @@ namespace muduo
 			// 取回所有
 			void retrieveAll()
 			{
-				readerIndex_ = kCheapPrepend;
-				writerIndex_ = kCheapPrepend;
+				if (!buffer_.empty())
+				{
+					readerIndex_ = kCheapPrepend;
+					writerIndex_ = kCheapPrepend;
+				}
 			}
 
 			//检索所有数据并且返回字符串
@@ -424,23 +432,45 @@ namespace muduo
 			// 从套接字中读取数据并添加到当前缓冲区中
 			ssize_t readFd(int fd, int* savedErrno);
 
+			/// Reads at most len bytes into the writable space, making room first.
+			/// No stack buffer, a short read means the socket has been drained.
+			/// @return result of read(2), @c errno is saved
+			ssize_t readFd(int fd, size_t len, int* savedErrno);
+
 		private:
+			friend class BufferPool;
+
+			// no storage, see BufferPool::emptyBuffer()
+			struct NoStorage {};
+			explicit Buffer(NoStorage)
+				: readerIndex_(0),
+				writerIndex_(0)
+			{
+			}
 
+			// data() is valid for a Buffer without storage
 			char* begin()
 			{
-				return &*buffer_.begin();
+				return buffer_.data();
 			}
 
 			const char* begin() const
 			{
-				return &*buffer_.begin();
+				return buffer_.data();
 			}
 
 			// 扩充空间
 			void makeSpace(size_t len)
 			{
+				if (buffer_.empty())
+				{
+					// storage was given back to BufferPool, start over
+					buffer_.resize(kCheapPrepend + len);
+					readerIndex_ = kCheapPrepend;
+					writerIndex_ = kCheapPrepend;
+				}
 			    // 如果可写空间+可读空间前面的空间 < len + 8字节
-				if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+				else if (writableBytes() + prependableBytes() < len + kCheapPrepend)
 				{
 					// FIXME: move readable data
 					// 开辟新的空间，重置一下容器的空间
@@ -463,8 +493,6 @@ namespace muduo
 			std::vector<char> buffer_;			//vector用于替代固定大小的数组
 			size_t readerIndex_;				//读位置
 			size_t writerIndex_;				//写位置
-
-			static const char kCRLF[];
 		};
 
 	}  // namespace net
@@ -0,0 +1,374 @@
+#include "muduo/net/BufferChain.h"
+
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferChain::kChunkSize;
+const int BufferChain::kMaxIovecs;
+
+FileRegion::FileRegion(int fd, off_t offset, size_t length)
+	: fd_(::dup(fd)),
+	offset_(offset),
+	length_(length)
+{
+}
+
+FileRegion::~FileRegion()
+{
+	if (fd_ >= 0)
+	{
+		::close(fd_);
+	}
+}
+
+BufferChain::Chunk::Chunk(Buffer&& buf)
+	: buffer(std::move(buf))
+{
+}
+
+BufferChain::Chunk::Chunk(const Payload& data)
+	: buffer(BufferPool::emptyBuffer()),
+	payload(data)
+{
+}
+
+BufferChain::Chunk::Chunk(const FileRegionPtr& region)
+	: buffer(BufferPool::emptyBuffer()),
+	file(region)
+{
+}
+
+void BufferChain::Chunk::retrieve(size_t len)
+{
+	if (isFile())
+	{
+		file->advance(len);
+		if (file->length() == 0)
+		{
+			// 关闭文件
+			file.reset();
+		}
+	}
+	else if (isPayload())
+	{
+		payload.removePrefix(len);
+		if (payload.empty())
+		{
+			// 释放引用
+			payload = Payload();
+		}
+	}
+	else
+	{
+		buffer.retrieve(len);
+	}
+}
+
+// 初始只有一个默认大小的chunk，与原来的outputBuffer_占用的内存一样
+// 使用内存池时这个chunk没有存储空间，第一次写入时才从池中取
+BufferChain::BufferChain(BufferPool* pool)
+	: pool_(pool),
+	chunks_(1, Chunk(pool ? BufferPool::emptyBuffer() : Buffer())),
+	readableBytes_(0),
+	zeroCopyNextId_(0),
+	zeroCopyThreshold_(0),
+	zeroCopyCopied_(0)
+{
+}
+
+void BufferChain::append(const void* /*restrict*/ data, size_t len)
+{
+	if (len == 0)
+	{
+		return;
+	}
+	tailChunkFor(len).append(data, len);
+	readableBytes_ += len;
+}
+
+void BufferChain::append(Buffer* buf)
+{
+	const size_t len = buf->readableBytes();
+	if (len <= Buffer::kInitialSize)
+	{
+		// small piece, copying is cheaper than a new chunk
+		append(buf->peek(), len);
+		buf->retrieveAll();
+		return;
+	}
+
+	if (chunks_.back().readableBytes() != 0)
+	{
+		chunks_.push_back(Chunk(Buffer(0)));
+	}
+	else if (!BufferPool::hasStorage(chunks_.back().buffer))
+	{
+		// buf gets the tail's storage back, it must be a usable Buffer
+		chunks_.back().buffer = Buffer(0);
+	}
+	// 尾部chunk为空，直接交换数据
+	chunks_.back().buffer.swap(*buf);
+	buf->retrieveAll();
+	readableBytes_ += len;
+}
+
+void BufferChain::append(const Payload& payload)
+{
+	const size_t len = payload.size();
+	if (len <= Buffer::kInitialSize)
+	{
+		append(payload.data(), len);
+		return;
+	}
+
+	emptyTailChunk().payload = payload;
+	readableBytes_ += len;
+}
+
+void BufferChain::append(const FileRegionPtr& file)
+{
+	if (file->length() == 0)
+	{
+		return;
+	}
+	emptyTailChunk().file = file;
+	readableBytes_ += file->length();
+}
+
+// 空的尾部chunk直接拿来用，否则追加一个没有存储空间的chunk
+BufferChain::Chunk& BufferChain::emptyTailChunk()
+{
+	Chunk& tail = chunks_.back();
+	if (tail.readableBytes() != 0)
+	{
+		chunks_.push_back(Chunk(BufferPool::emptyBuffer()));
+		return chunks_.back();
+	}
+	if (pool_ && BufferPool::hasStorage(tail.buffer))
+	{
+		pool_->release(&tail.buffer);
+	}
+	tail.buffer = BufferPool::emptyBuffer();
+	return tail;
+}
+
+void BufferChain::retrieve(size_t len)
+{
+	assert(len <= readableBytes_);
+	readableBytes_ -= len;
+	while (len > 0)
+	{
+		Chunk& front = chunks_.front();
+		size_t n = std::min(len, front.readableBytes());
+		front.retrieve(n);
+		len -= n;
+		// 前面的chunk发送完了就释放，总是保留最后一个chunk用于写入
+		if (front.readableBytes() == 0 && chunks_.size() > 1)
+		{
+			popFront();
+		}
+	}
+	if (readableBytes_ == 0 && pool_ && BufferPool::hasStorage(chunks_.front().buffer))
+	{
+		// 全部发送完毕，最后一个chunk也还给内存池
+		pool_->release(&chunks_.front().buffer);
+	}
+}
+
+void BufferChain::retrieveAll()
+{
+	while (chunks_.size() > 1)
+	{
+		chunks_.front().retrieve(chunks_.front().readableBytes());
+		popFront();
+	}
+	Chunk& last = chunks_.front();
+	last.retrieve(last.readableBytes());
+	readableBytes_ = 0;
+	if (pool_ && BufferPool::hasStorage(last.buffer))
+	{
+		pool_->release(&last.buffer);
+	}
+}
+
+int BufferChain::peekIovec(struct iovec* iov, int maxiov) const
+{
+	int iovcnt = 0;
+	for (std::deque<Chunk>::const_iterator it = chunks_.begin();
+		it != chunks_.end() && iovcnt < maxiov; ++it)
+	{
+		if (it->isFile())
+		{
+			break;
+		}
+		if (it->readableBytes() > 0)
+		{
+			iov[iovcnt].iov_base = const_cast<char*>(it->peek());
+			iov[iovcnt].iov_len = it->readableBytes();
+			++iovcnt;
+		}
+	}
+	return iovcnt;
+}
+
+ssize_t BufferChain::writeFd(int fd, int* savedErrno)
+{
+	const Chunk& front = chunks_.front();
+	if (front.isFile())
+	{
+		FileRegionPtr file(front.file);
+		off_t offset = file->offset();
+		const ssize_t n = sockets::sendfile(fd, file->fd(), &offset, file->length());
+		if (n > 0)
+		{
+			retrieve(implicit_cast<size_t>(n));
+		}
+		else
+		{
+			if (n < 0)
+			{
+				*savedErrno = errno;
+			}
+			// 文件变短了或者读不了，丢掉剩下的部分，否则会一直POLLOUT
+			if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			{
+				retrieve(file->length());
+			}
+		}
+		return n;
+	}
+
+	if (zeroCopyThreshold_ > 0 && front.isPayload()
+		&& front.payload.size() >= zeroCopyThreshold_)
+	{
+		const ssize_t n = sendZeroCopy(fd, front.payload);
+		if (n < 0)
+		{
+			*savedErrno = errno;
+		}
+		else
+		{
+			retrieve(implicit_cast<size_t>(n));
+		}
+		return n;
+	}
+
+	struct iovec vec[kMaxIovecs];
+	const int iovcnt = peekIovec(vec, kMaxIovecs);
+	const ssize_t n = sockets::writev(fd, vec, iovcnt);
+	if (n < 0)
+	{
+		*savedErrno = errno;
+	}
+	else
+	{
+		retrieve(implicit_cast<size_t>(n));
+	}
+	return n;
+}
+
+ssize_t BufferChain::sendZeroCopy(int fd, const Payload& payload)
+{
+	ssize_t n = sockets::sendZeroCopy(fd, payload.data(), payload.size());
+	if (n >= 0)
+	{
+		zeroCopyPending_.push_back(ZeroCopySend(zeroCopyNextId_++, payload));
+	}
+	else if (errno == ENOBUFS)
+	{
+		// optmem_max reached, copy this time
+		n = sockets::write(fd, payload.data(), payload.size());
+	}
+	return n;
+}
+
+int BufferChain::handleZeroCopyCompletions(int fd)
+{
+	int count = 0;
+	uint32_t lo = 0;
+	uint32_t hi = 0;
+	bool copied = false;
+	int ret = 0;
+	while ((ret = sockets::readZeroCopyCompletion(fd, &lo, &hi, &copied)) >= 0)
+	{
+		if (ret == 0)
+		{
+			continue;
+		}
+		++count;
+		if (copied)
+		{
+			++zeroCopyCopied_;
+		}
+		// id会回绕，用无符号减法比较
+		for (std::deque<ZeroCopySend>::iterator it = zeroCopyPending_.begin();
+			it != zeroCopyPending_.end(); ++it)
+		{
+			if (it->first - lo <= hi - lo)
+			{
+				it->second = Payload();
+			}
+		}
+		while (!zeroCopyPending_.empty() && zeroCopyPending_.front().second.empty())
+		{
+			zeroCopyPending_.pop_front();
+		}
+	}
+	return count;
+}
+
+Buffer& BufferChain::tailChunkFor(size_t len)
+{
+	Chunk& tail = chunks_.back();
+	// a chunk referring to a payload has no storage, the checks below see it as full
+	if (tail.buffer.writableBytes() >= len)
+	{
+		return tail.buffer;
+	}
+	if (tail.readableBytes() == 0)
+	{
+		if (pool_)
+		{
+			if (BufferPool::hasStorage(tail.buffer))
+			{
+				pool_->release(&tail.buffer);
+			}
+			pool_->acquire(&tail.buffer, len);
+		}
+		else
+		{
+			// nothing to move, growing the empty tail is cheap
+			tail.buffer.ensureWritableBytes(len);
+		}
+		return tail.buffer;
+	}
+	// never grow a chunk which holds data, that would memmove and realloc it
+	if (pool_)
+	{
+		chunks_.push_back(Chunk(BufferPool::emptyBuffer()));
+		pool_->acquire(&chunks_.back().buffer, std::max(len, kChunkSize));
+	}
+	else
+	{
+		chunks_.push_back(Chunk(Buffer(std::max(len, kChunkSize))));
+	}
+	return chunks_.back().buffer;
+}
+
+void BufferChain::popFront()
+{
+	if (pool_)
+	{
+		pool_->release(&chunks_.front().buffer);
+	}
+	chunks_.pop_front();
+}
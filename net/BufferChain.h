@@ -0,0 +1,204 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERCHAIN_H
+#define MUDUO_NET_BUFFERCHAIN_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/Payload.h"
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include <sys/types.h>
+
+struct iovec;
+
+namespace muduo
+{
+	namespace net
+	{
+
+		class BufferPool;
+
+		/// A part of a file queued for sendfile(2).
+		/// Owns a dup() of the file descriptor, the caller may close its own.
+		// 文件区间，发送完毕或者连接关闭时关闭复制的文件描述符
+		class FileRegion : noncopyable
+		{
+		public:
+			FileRegion(int fd, off_t offset, size_t length);
+			~FileRegion();
+
+			bool valid() const { return fd_ >= 0; }
+			int fd() const { return fd_; }
+			off_t offset() const { return offset_; }
+			size_t length() const { return length_; }
+
+			void advance(size_t n)
+			{
+				offset_ += static_cast<off_t>(n);
+				length_ -= n;
+			}
+
+		private:
+			const int fd_;
+			off_t offset_;
+			size_t length_;	// 剩余未发送的字节数
+		};
+
+		typedef std::shared_ptr<FileRegion> FileRegionPtr;
+
+		/// A queue of Buffer chunks, used as the output buffer of TcpConnection.
+		///
+		/// @code
+		/// +--------------+    +--------------+    +--------------+
+		/// |  chunk (64k) | -> |  chunk (64k) | -> | chunk (tail) |
+		/// +--------------+    +--------------+    +--------------+
+		///     ^ peek                                    append ^
+		/// @endcode
+		///
+		/// Appending never moves bytes that are already queued, the data goes
+		/// into the free space of the tail chunk or into a new chunk.
+		/// Retrieving pops the drained chunks from the front.
+		/// A chunk may also refer to a Payload, which is queued without copying,
+		/// or to a FileRegion, which is sent with sendfile(2) in its turn.
+		/// writeFd() sends as many chunks as possible with one writev(2).
+		///
+		/// With a BufferPool, chunks are taken from the pool and go back to it
+		/// once drained, an empty chain holds no storage.
+		// 把多个Buffer串起来，避免大量数据积压时Buffer::makeSpace反复搬移和扩容
+		class BufferChain : noncopyable
+		{
+		public:
+			static const size_t kChunkSize = 64 * 1024;	// 新分配chunk的大小
+			static const int kMaxIovecs = 64;		// 一次writev最多发送的chunk数
+
+			explicit BufferChain(BufferPool* pool = NULL);
+
+			size_t readableBytes() const { return readableBytes_; }
+			bool empty() const { return readableBytes_ == 0; }
+			size_t numChunks() const { return chunks_.size(); }
+
+			/// Takes chunks from pool from now on. Call when empty, then the chain
+			/// holds no storage of the old pool.
+			void setPool(BufferPool* pool)
+			{
+				assert(empty());
+				pool_ = pool;
+			}
+
+			void append(const StringPiece& str)
+			{
+				append(str.data(), str.size());
+			}
+
+			void append(const void* /*restrict*/ data, size_t len);
+
+			/// Takes the readable bytes of buf without copying them,
+			/// buf is left empty.
+			// 交换数据而不拷贝，buf会被清空
+			void append(Buffer* buf);
+
+			/// Queues a reference to payload, small ones are copied.
+			void append(const Payload& payload);
+
+			/// Queues a file region, sent with sendfile(2) after the data before it.
+			void append(const FileRegionPtr& file);
+
+			/// Drops len bytes from the front.
+			void retrieve(size_t len);
+			void retrieveAll();
+
+			/// Fills at most maxiov entries of iov with the readable chunks,
+			/// stops at the first file region.
+			/// @return number of entries filled
+			int peekIovec(struct iovec* iov, int maxiov) const;
+
+			/// Writes queued data with writev(2), retrieves what was written.
+			/// If a file region is at the front, sends it with sendfile(2) instead.
+			/// A region that can't be read any more is dropped.
+			///
+			/// @return result of writev(2), @c errno is saved
+			// 把缓冲区中的数据用一次writev写到套接字中
+			ssize_t writeFd(int fd, int* savedErrno);
+
+			/// Payload chunks of at least bytes are sent with MSG_ZEROCOPY, 0 turns it off.
+			/// The socket must have SO_ZEROCOPY set.
+			void setZeroCopyThreshold(size_t bytes) { zeroCopyThreshold_ = bytes; }
+			size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+			/// Sends payload with MSG_ZEROCOPY and keeps a reference to it until
+			/// the kernel reports the send complete. Copies if the kernel is short of
+			/// option memory (ENOBUFS).
+			ssize_t sendZeroCopy(int fd, const Payload& payload);
+
+			/// Reads the completions from the error queue of fd and
+			/// releases the payloads the kernel is done with.
+			/// @return number of completions read
+			int handleZeroCopyCompletions(int fd);
+
+			size_t numZeroCopyPending() const { return zeroCopyPending_.size(); }
+			/// completions where the kernel copied after all, e.g. on loopback
+			int64_t numZeroCopyCopied() const { return zeroCopyCopied_; }
+
+		private:
+			// 一段待发送的数据，在buffer中或者引用一个payload
+			struct Chunk
+			{
+				explicit Chunk(Buffer&& buf);
+				explicit Chunk(const Payload& data);
+				explicit Chunk(const FileRegionPtr& region);
+
+				bool isPayload() const { return !payload.empty(); }
+				bool isFile() const { return static_cast<bool>(file); }
+
+				size_t readableBytes() const
+				{
+					if (isFile())
+					{
+						return file->length();
+					}
+					return isPayload() ? payload.size() : buffer.readableBytes();
+				}
+
+				const char* peek() const
+				{
+					return isPayload() ? payload.data() : buffer.peek();
+				}
+
+				void retrieve(size_t len);
+
+				Buffer buffer;		// payload和file都为空时使用
+				Payload payload;
+				FileRegionPtr file;
+			};
+
+			Chunk& emptyTailChunk();
+
+			Buffer& tailChunkFor(size_t len);
+			void popFront();
+
+			BufferPool* pool_;			// 可以为空
+			std::deque<Chunk> chunks_;	// 最后一个chunk是写入的位置
+			size_t readableBytes_;		// 所有chunk的可读字节数之和
+
+			// MSG_ZEROCOPY发送之后，内核用完之前要一直持有payload
+			typedef std::pair<uint32_t, Payload> ZeroCopySend;
+			std::deque<ZeroCopySend> zeroCopyPending_;	// 按id递增
+			uint32_t zeroCopyNextId_;	// 内核给下一次零拷贝发送分配的id
+			size_t zeroCopyThreshold_;
+			int64_t zeroCopyCopied_;
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERCHAIN_H
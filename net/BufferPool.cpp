@@ -0,0 +1,103 @@
+#include "muduo/net/BufferPool.h"
+
+#include "muduo/net/BufferChain.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kDefaultMaxPooledBytes;
+
+// 可写空间的大小，实际分配还要加上kCheapPrepend
+const size_t BufferPool::kClassSizes[kNumClasses] =
+{
+	Buffer::kInitialSize,
+	4 * 1024,
+	16 * 1024,
+	BufferChain::kChunkSize,
+};
+
+BufferPool::BufferPool()
+	: pooledBytes_(0),
+	maxPooledBytes_(kDefaultMaxPooledBytes),
+	hits_(0),
+	misses_(0)
+{
+}
+
+void BufferPool::acquire(Buffer* buf, size_t len)
+{
+	assert(!hasStorage(*buf));
+	int cls = 0;
+	while (cls < kNumClasses && kClassSizes[cls] < len)
+	{
+		++cls;
+	}
+
+	std::vector<char> storage;
+	if (cls == kNumClasses)
+	{
+		// 超过最大的级别，不经过池
+		storage.resize(Buffer::kCheapPrepend + len);
+		++misses_;
+	}
+	else if (freeLists_[cls].empty())
+	{
+		storage.resize(Buffer::kCheapPrepend + kClassSizes[cls]);
+		++misses_;
+	}
+	else
+	{
+		storage.swap(freeLists_[cls].back());
+		freeLists_[cls].pop_back();
+		pooledBytes_ -= storage.capacity();
+		++hits_;
+	}
+
+	buf->buffer_.swap(storage);
+	buf->readerIndex_ = Buffer::kCheapPrepend;
+	buf->writerIndex_ = Buffer::kCheapPrepend;
+}
+
+void BufferPool::release(Buffer* buf)
+{
+	assert(buf->readableBytes() == 0);
+	std::vector<char> storage;
+	storage.swap(buf->buffer_);
+	buf->readerIndex_ = 0;
+	buf->writerIndex_ = 0;
+
+	if (storage.size() < Buffer::kCheapPrepend + kClassSizes[0])
+	{
+		return;
+	}
+	const size_t writable = storage.size() - Buffer::kCheapPrepend;
+	// don't pin a buffer which grew far beyond the biggest class
+	if (writable > 2 * kClassSizes[kNumClasses - 1]
+		|| pooledBytes_ + storage.capacity() > maxPooledBytes_)
+	{
+		return;
+	}
+
+	// 放入不超过其大小的最大级别
+	int cls = kNumClasses - 1;
+	while (kClassSizes[cls] > writable)
+	{
+		--cls;
+	}
+	storage.resize(Buffer::kCheapPrepend + kClassSizes[cls]);
+	pooledBytes_ += storage.capacity();
+	freeLists_[cls].push_back(std::vector<char>());
+	freeLists_[cls].back().swap(storage);
+}
+
+size_t BufferPool::sizeClassOf(const Buffer& buf)
+{
+	const size_t size = buf.buffer_.size();
+	int cls = 0;
+	while (cls + 1 < kNumClasses && Buffer::kCheapPrepend + kClassSizes[cls + 1] <= size)
+	{
+		++cls;
+	}
+	return kClassSizes[cls];
+}
@@ -0,0 +1,75 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+
+#include "muduo/net/Buffer.h"
+
+#include <vector>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		/// Free lists of Buffer storage in a few size classes, owned by EventLoop.
+		///
+		/// TcpConnection takes storage from the pool before reading or queuing
+		/// output, and gives it back as soon as the buffer is drained, so an
+		/// idle connection holds no buffer memory at all.
+		/// Storage much larger than the biggest size class goes back to malloc,
+		/// a buffer which once grew to megabytes doesn't stay that large.
+		///
+		/// Not thread safe, it must only be used in the loop thread.
+		// 每个EventLoop一个，不加锁
+		class BufferPool : noncopyable
+		{
+		public:
+			static const int kNumClasses = 4;	// 1k 4k 16k 64k
+			static const size_t kDefaultMaxPooledBytes = 8 * 1024 * 1024;
+
+			BufferPool();
+
+			/// A Buffer without storage, it costs no allocation.
+			static Buffer emptyBuffer() { return Buffer(Buffer::NoStorage()); }
+
+			static bool hasStorage(const Buffer& buf) { return !buf.buffer_.empty(); }
+
+			/// Gives buf storage for at least len writable bytes.
+			/// buf must have no storage.
+			void acquire(Buffer* buf, size_t len);
+
+			/// Takes the storage of buf, which must have no readable bytes.
+			/// buf is left without storage.
+			void release(Buffer* buf);
+
+			/// Writable bytes of the size class acquire() would pick for buf.
+			static size_t sizeClassOf(const Buffer& buf);
+
+			void setMaxPooledBytes(size_t bytes) { maxPooledBytes_ = bytes; }
+			size_t pooledBytes() const { return pooledBytes_; }
+			int64_t numHits() const { return hits_; }
+			int64_t numMisses() const { return misses_; }
+
+		private:
+			typedef std::vector<std::vector<char> > FreeList;
+
+			static const size_t kClassSizes[kNumClasses];
+
+			FreeList freeLists_[kNumClasses];
+			size_t pooledBytes_;
+			size_t maxPooledBytes_;
+			int64_t hits_;
+			int64_t misses_;
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERPOOL_H
@@ -0,0 +1,270 @@
+#include "muduo/net/BufferSearch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MUDUO_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace muduo::net;
+
+namespace
+{
+
+	// scalar fallback, memchr() is already fast for a single character
+	const char* findCRLFScalar(const char* begin, const char* end)
+	{
+		const char* p = begin;
+		while (end - p >= 2)
+		{
+			// '\r'后面至少要留一个字节给'\n'
+			const char* cr = static_cast<const char*>(memchr(p, '\r', end - p - 1));
+			if (cr == NULL)
+			{
+				return NULL;
+			}
+			if (cr[1] == '\n')
+			{
+				return cr;
+			}
+			p = cr + 1;
+		}
+		return NULL;
+	}
+
+	const char* findAnyOfScalar(const char* begin, const char* end,
+		const char* delims, size_t ndelims)
+	{
+		if (ndelims == 1)
+		{
+			return static_cast<const char*>(memchr(begin, delims[0], end - begin));
+		}
+		bool table[256] = { false };
+		for (size_t i = 0; i < ndelims; ++i)
+		{
+			table[static_cast<unsigned char>(delims[i])] = true;
+		}
+		for (const char* p = begin; p < end; ++p)
+		{
+			if (table[static_cast<unsigned char>(*p)])
+			{
+				return p;
+			}
+		}
+		return NULL;
+	}
+
+#ifdef MUDUO_SEARCH_X86
+
+	// SSE2 is the baseline of x86-64.
+	// Compare 16 bytes against '\r' and the next 16 bytes against '\n',
+	// the first bit set in (cr & lf) is the position of "\r\n".
+	__attribute__((target("sse2")))
+	const char* findCRLFSse2(const char* begin, const char* end)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const char* p = begin;
+		while (end - p >= 17)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+			int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr),
+				_mm_cmpeq_epi8(b, lf)));
+			if (mask != 0)
+			{
+				return p + __builtin_ctz(mask);
+			}
+			p += 16;
+		}
+		return findCRLFScalar(p, end);
+	}
+
+	// PCMPESTRI compares 16 bytes against a set of up to 16 delimiters at once.
+	__attribute__((target("sse4.2")))
+	const char* findAnyOfSse42(const char* begin, const char* end,
+		const char* delims, size_t ndelims)
+	{
+		if (ndelims > 16)
+		{
+			return findAnyOfScalar(begin, end, delims, ndelims);
+		}
+		char set[16] = { 0 };
+		memcpy(set, delims, ndelims);
+		const __m128i needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set));
+		const int nlen = static_cast<int>(ndelims);
+		const char* p = begin;
+		while (end - p >= 16)
+		{
+			__m128i hay = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			int idx = _mm_cmpestri(needle, nlen, hay, 16,
+				_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+			if (idx < 16)
+			{
+				return p + idx;
+			}
+			p += 16;
+		}
+		return findAnyOfScalar(p, end, delims, ndelims);
+	}
+
+	// Only the '\r' compare runs on every block, the '\n' one runs when a '\r'
+	// shows up, which is rare in header values and bodies.
+	// Two blocks per iteration to keep the loads in flight.
+	__attribute__((target("avx2")))
+	const char* findCRLFAvx2(const char* begin, const char* end)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		const char* p = begin;
+		while (end - p >= 129)
+		{
+			__m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			__m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+			__m256i a2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64));
+			__m256i a3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 96));
+			__m256i eq = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(a0, cr), _mm256_cmpeq_epi8(a1, cr)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(a2, cr), _mm256_cmpeq_epi8(a3, cr)));
+			if (!_mm256_testz_si256(eq, eq))
+			{
+				break;
+			}
+			p += 128;
+		}
+		while (end - p >= 33)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, cr)));
+			if (mask != 0)
+			{
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+				mask &= static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, lf)));
+				if (mask != 0)
+				{
+					return p + __builtin_ctz(mask);
+				}
+			}
+			p += 32;
+		}
+		return findCRLFScalar(p, end);
+	}
+
+	// One compare per delimiter is cheaper than PCMPESTRI for a few delimiters,
+	// which is the common case: "\r\n", " \r\n", ":\r\n".
+	const size_t kMaxAvx2Delims = 8;
+
+	__attribute__((target("avx2")))
+	const char* findAnyOfAvx2(const char* begin, const char* end,
+		const char* delims, size_t ndelims)
+	{
+		if (ndelims > kMaxAvx2Delims)
+		{
+			return findAnyOfSse42(begin, end, delims, ndelims);
+		}
+		__m256i set[kMaxAvx2Delims];
+		for (size_t i = 0; i < ndelims; ++i)
+		{
+			set[i] = _mm256_set1_epi8(delims[i]);
+		}
+		const char* p = begin;
+		while (end - p >= 32)
+		{
+			__m256i hay = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			__m256i eq = _mm256_cmpeq_epi8(hay, set[0]);
+			for (size_t i = 1; i < ndelims; ++i)
+			{
+				eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(hay, set[i]));
+			}
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+			if (mask != 0)
+			{
+				return p + __builtin_ctz(mask);
+			}
+			p += 32;
+		}
+		return findAnyOfSse42(p, end, delims, ndelims);
+	}
+
+#endif  // MUDUO_SEARCH_X86
+
+	// 从慢到快
+	size_t supportedKernels(detail::SearchKernels* kernels, size_t max)
+	{
+#ifdef MUDUO_SEARCH_X86
+		__builtin_cpu_init();
+		const bool sse2 = __builtin_cpu_supports("sse2");
+		const bool sse42 = __builtin_cpu_supports("sse4.2");
+		const bool avx2 = __builtin_cpu_supports("avx2") && sse42;
+#endif
+		const struct
+		{
+			detail::SearchKernels kernels;
+			bool supported;
+		} all[] =
+		{
+			{ { "scalar", findCRLFScalar, findAnyOfScalar }, true },
+#ifdef MUDUO_SEARCH_X86
+			{ { "sse2", findCRLFSse2, findAnyOfScalar }, sse2 },
+			{ { "sse4.2", findCRLFSse2, findAnyOfSse42 }, sse42 },
+			{ { "avx2", findCRLFAvx2, findAnyOfAvx2 }, avx2 },
+#endif
+		};
+		size_t n = 0;
+		for (size_t i = 0; i < sizeof all / sizeof all[0] && n < max; ++i)
+		{
+			if (all[i].supported)
+			{
+				kernels[n++] = all[i].kernels;
+			}
+		}
+		return n;
+	}
+
+	detail::SearchKernels selectKernels()
+	{
+		detail::SearchKernels kernels[4];
+		size_t n = supportedKernels(kernels, 4);
+		// 设置MUDUO_NO_SIMD环境变量可以强制使用标量实现，便于对比测试
+		if (::getenv("MUDUO_NO_SIMD"))
+		{
+			return kernels[0];
+		}
+		return kernels[n - 1];
+	}
+
+	// thread safe initialization on first use, Buffer may be used before main()
+	const detail::SearchKernels& kernels()
+	{
+		static const detail::SearchKernels k = selectKernels();
+		return k;
+	}
+
+}  // namespace
+
+const char* detail::findCRLF(const char* begin, const char* end)
+{
+	return kernels().findCRLF(begin, end);
+}
+
+const char* detail::findAnyOf(const char* begin, const char* end,
+	const char* delims, size_t ndelims)
+{
+	if (ndelims == 0)
+	{
+		return NULL;
+	}
+	return kernels().findAnyOf(begin, end, delims, ndelims);
+}
+
+const char* detail::searchKernelName()
+{
+	return kernels().name;
+}
+
+size_t detail::availableSearchKernels(SearchKernels* kernels, size_t max)
+{
+	return supportedKernels(kernels, max);
+}
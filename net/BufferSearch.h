@@ -0,0 +1,53 @@
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_BUFFERSEARCH_H
+#define MUDUO_NET_BUFFERSEARCH_H
+
+#include <stddef.h>
+
+namespace muduo
+{
+	namespace net
+	{
+		namespace detail
+		{
+
+			///
+			/// Delimiter search used by Buffer::findCRLF() and Buffer::findAnyOf().
+			///
+			/// The kernel is chosen once at runtime by CPU dispatch:
+			/// AVX2, then SSE4.2/SSE2, then a scalar fallback.
+			/// All of them return NULL if nothing is found in [begin, end).
+			// 运行时根据CPU支持的指令集选择实现
+
+			// 查找"\r\n"
+			const char* findCRLF(const char* begin, const char* end);
+
+			// 查找delims中任意一个字符第一次出现的位置
+			const char* findAnyOf(const char* begin, const char* end,
+				const char* delims, size_t ndelims);
+
+			// "avx2", "sse4.2", "sse2" or "scalar", for logging and benchmarks
+			const char* searchKernelName();
+
+			typedef const char* (*FindCRLFFunc)(const char* begin, const char* end);
+			typedef const char* (*FindAnyOfFunc)(const char* begin, const char* end,
+				const char* delims, size_t ndelims);
+
+			struct SearchKernels
+			{
+				const char* name;
+				FindCRLFFunc findCRLF;
+				FindAnyOfFunc findAnyOf;	// ndelims > 0
+			};
+
+			/// Fills kernels with every kernel this CPU can run, the scalar one
+			/// first, returns how many, at most max. Regardless of MUDUO_NO_SIMD,
+			/// for tests and benchmarks which check them against each other.
+			size_t availableSearchKernels(SearchKernels* kernels, size_t max);
+
+		}  // namespace detail
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERSEARCH_H
@@ -65,6 +65,11 @@ namespace muduo
 		typedef std::function<void(const TcpConnectionPtr&)> CloseCallback;
 		typedef std::function<void(const TcpConnectionPtr&)> WriteCompleteCallback;
 		typedef std::function<void(const TcpConnectionPtr&, size_t)> HighWaterMarkCallback;
+		typedef std::function<void(const TcpConnectionPtr&, bool)> MoveCallback;
+
+		// 空闲超时的种类，见TcpConnection::setIdleTimeout()
+		enum IdleEvent { kReadIdle, kWriteIdle, kAllIdle };
+		typedef std::function<void(const TcpConnectionPtr&, IdleEvent)> IdleCallback;
 
 		// the data has been read to (buf, len)
 		typedef std::function<void(const TcpConnectionPtr&,
@@ -20,6 +20,8 @@ Channel::Channel(EventLoop* loop, int fd__)
 	revents_(0),
 	index_(-1),//在构造Channel对象时，index是-1，在EpollPoller中是kNew的状态
 	logHup_(true),
+	edgeTriggered_(false),
+	exclusive_(false),
 	tied_(false),
 	eventHandling_(false),
 	addedToLoop_(false)
@@ -56,6 +58,13 @@ void Channel::remove()
 	loop_->removeChannel(this);
 }
 
+void Channel::setOwnerLoop(EventLoop* loop)
+{
+	assert(!addedToLoop_);
+	assert(!eventHandling_);
+	loop_ = loop;
+}
+
 //当事件到来时会调用handleEvent来处理
 void Channel::handleEvent(Timestamp receiveTime)
 {
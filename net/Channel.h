@@ -79,6 +79,22 @@ namespace muduo
 			bool isWriting() const { return events_ & kWriteEvent; }
 			bool isReading() const { return events_ & kReadEvent; }
 
+			/// Registers the fd once for reading and writing with EPOLLET, so
+			/// enabling and disabling writing costs no epoll_ctl(2). The owner must
+			/// read and write until EAGAIN, and enable writing only after EAGAIN.
+			/// Call before the first enable*(). Only EPollPoller honors it.
+			// 边沿触发，减少epoll_ctl调用
+			void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+			bool edgeTriggered() const { return edgeTriggered_; }
+
+			/// Registers the fd with EPOLLEXCLUSIVE, when the same file is watched
+			/// by several loops only one of them wakes up for an event. The events
+			/// can't be changed afterwards, only disableAll(). Call before the first
+			/// enable*(). Only EPollPoller honors it.
+			// 多个loop监听同一个socket时避免惊群
+			void setExclusive(bool on) { exclusive_ = on; }
+			bool exclusive() const { return exclusive_; }
+
 			// for Poller
 			int index() { return index_; }
 			void set_index(int idx) { index_ = idx; }
@@ -91,6 +107,8 @@ namespace muduo
 			void doNotLogHup() { logHup_ = false; }
 
 			EventLoop* ownerLoop() { return loop_; }
+			/// For TcpConnection::moveToLoop(), call after remove().
+			void setOwnerLoop(EventLoop* loop);
 			//移除
 			void remove();
 
@@ -110,6 +128,8 @@ namespace muduo
 			int        revents_;	// poll/epoll返回的事件
 			int        index_;	// used by Poller.在poll事件中表示数组中的序号，在epoll事件中表示通道的状态
 			bool       logHup_;
+			bool       edgeTriggered_;
+			bool       exclusive_;
 
 			std::weak_ptr<void> tie_;
 			bool tied_;
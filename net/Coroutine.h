@@ -0,0 +1,482 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+//
+// C++20 only, the rest of muduo stays C++11. Header only, nothing to link.
+
+#ifndef MUDUO_NET_COROUTINE_H
+#define MUDUO_NET_COROUTINE_H
+
+#if !defined(__cpp_impl_coroutine) || __cplusplus < 202002L
+#error "muduo/net/Coroutine.h needs C++20 coroutines, compile with -std=c++20"
+#endif
+
+#include "muduo/base/Types.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		/// Coroutines on top of the callbacks, for multi-step protocols.
+		///
+		///   Task<> session(CoConnection conn)
+		///   {
+		///     string line = co_await conn.readUntil("\r\n");
+		///     CoConnection upstream = co_await connectTo(conn.loop(), backendAddr, "upstream");
+		///     ...
+		///     co_await conn.drain();
+		///   }
+		///   // in the connection callback
+		///   session(CoConnection::attach(conn)).detach();
+		///
+		/// A coroutine always resumes in the thread of the loop its awaited
+		/// operation belongs to, from the callback which completed it. Awaiters
+		/// live in the coroutine frame, awaiting doesn't allocate except what the
+		/// callback would allocate anyway, e.g. the Timer of sleepFor().
+		/// Not thread safe, use a connection only in its loop thread.
+
+		template<typename T = void>
+		class Task;
+
+		namespace detail
+		{
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept { return false; }
+
+				// 结束时回到等待者，没有等待者的分离任务自己销毁
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					Promise& promise = handle.promise();
+					if (promise.continuation)
+					{
+						return promise.continuation;
+					}
+					if (promise.detached)
+					{
+						if (promise.exception)
+						{
+							// 和回调中抛出异常一样，没有人能处理
+							std::rethrow_exception(promise.exception);
+						}
+						handle.destroy();
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() noexcept { }
+			};
+
+			struct PromiseBase
+			{
+				std::coroutine_handle<> continuation;
+				std::exception_ptr exception;
+				bool detached = false;
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				FinalAwaiter final_suspend() noexcept { return {}; }
+				void unhandled_exception() { exception = std::current_exception(); }
+			};
+
+			template<typename T>
+			struct Promise : PromiseBase
+			{
+				std::optional<T> value;
+
+				Task<T> get_return_object();
+				void return_value(T v) { value.emplace(std::move(v)); }
+
+				T result()
+				{
+					if (exception)
+					{
+						std::rethrow_exception(exception);
+					}
+					return std::move(*value);
+				}
+			};
+
+			template<>
+			struct Promise<void> : PromiseBase
+			{
+				Task<void> get_return_object();
+				void return_void() { }
+
+				void result()
+				{
+					if (exception)
+					{
+						std::rethrow_exception(exception);
+					}
+				}
+			};
+		}  // namespace detail
+
+		/// A lazily started coroutine. co_await it from another coroutine,
+		/// or detach() it to run on its own until it finishes.
+		template<typename T>
+		class Task : noncopyable
+		{
+		public:
+			typedef detail::Promise<T> promise_type;
+			typedef std::coroutine_handle<promise_type> Handle;
+
+			explicit Task(Handle handle) : handle_(handle) { }
+			Task(Task&& rhs) noexcept : handle_(std::exchange(rhs.handle_, nullptr)) { }
+			~Task()
+			{
+				if (handle_)
+				{
+					handle_.destroy();
+				}
+			}
+
+			/// Starts the coroutine, which destroys itself when it finishes.
+			void detach()
+			{
+				Handle handle = std::exchange(handle_, nullptr);
+				handle.promise().detached = true;
+				handle.resume();
+			}
+
+			auto operator co_await() && noexcept
+			{
+				struct Awaiter
+				{
+					Handle handle;
+
+					bool await_ready() noexcept { return false; }
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+					{
+						handle.promise().continuation = awaiting;
+						return handle;
+					}
+					T await_resume() { return handle.promise().result(); }
+				};
+				return Awaiter{ handle_ };
+			}
+
+		private:
+			Handle handle_;
+		};
+
+		namespace detail
+		{
+			template<typename T>
+			Task<T> Promise<T>::get_return_object()
+			{
+				return Task<T>(std::coroutine_handle<Promise<T> >::from_promise(*this));
+			}
+
+			inline Task<void> Promise<void>::get_return_object()
+			{
+				return Task<void>(std::coroutine_handle<Promise<void> >::from_promise(*this));
+			}
+		}  // namespace detail
+
+		/// Resumes after seconds, in the loop thread.
+		/// Call it in the loop thread.
+		inline auto sleepFor(EventLoop* loop, double seconds)
+		{
+			struct Awaiter
+			{
+				EventLoop* loop;
+				double seconds;
+
+				bool await_ready() noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					loop->runAfter(seconds, [handle] { handle.resume(); });
+				}
+				void await_resume() noexcept { }
+			};
+			return Awaiter{ loop, seconds };
+		}
+
+		/// Moves the coroutine to the thread of loop, e.g. to use a connection
+		/// of another loop. Resumes at once if already there.
+		inline auto switchTo(EventLoop* loop)
+		{
+			struct Awaiter
+			{
+				EventLoop* loop;
+
+				bool await_ready() noexcept { return loop->isInLoopThread(); }
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					loop->queueInLoop([handle] { handle.resume(); });
+				}
+				void await_resume() noexcept { }
+			};
+			return Awaiter{ loop };
+		}
+
+		/// A TcpConnection driven by a coroutine instead of callbacks.
+		/// Takes over the connection, message and write complete callbacks of
+		/// the connection. Bytes arriving while no read is pending stay in the
+		/// input buffer. Cheap to copy, all copies refer to the same state.
+		/// Once the last copy is gone events are ignored, shut the connection
+		/// down before that.
+		class CoConnection
+		{
+		public:
+			/// Call it in the loop thread, e.g. in the connection callback.
+			/// It replaces the callback being run, so make it the last thing the
+			/// callback does with its captures.
+			static CoConnection attach(const TcpConnectionPtr& conn)
+			{
+				return CoConnection(conn, std::shared_ptr<TcpClient>());
+			}
+
+			const TcpConnectionPtr& connection() const { return state_->conn; }
+			EventLoop* loop() const { return state_->conn->getLoop(); }
+			bool connected() const { return state_->conn->connected(); }
+
+			void send(const char* message) { state_->conn->send(message); }
+			void send(const StringPiece& message) { state_->conn->send(message); }
+			void send(string&& message) { state_->conn->send(std::move(message)); }
+			void shutdown() { state_->conn->shutdown(); }
+
+			class ReadAwaiter;
+
+			/// Exactly n bytes, fewer only if the peer closed the connection.
+			ReadAwaiter read(size_t n);
+			/// Up to and including delim, empty if the connection closed first.
+			ReadAwaiter readUntil(const StringPiece& delim);
+
+			/// Resumes once the output buffer has been written to the socket
+			/// or the connection closed.
+			auto drain()
+			{
+				struct Awaiter
+				{
+					State* state;
+
+					bool await_ready() noexcept
+					{
+						return state->closed || state->conn->outputBuffer()->empty();
+					}
+					void await_suspend(std::coroutine_handle<> handle) noexcept
+					{
+						assert(!state->drainer);
+						state->drainer = handle;
+					}
+					void await_resume() noexcept { }
+				};
+				return Awaiter{ state_.get() };
+			}
+
+		private:
+			friend class ConnectAwaiter;
+
+			struct State
+			{
+				TcpConnectionPtr conn;
+				std::shared_ptr<TcpClient> client;	// connectTo()建立的连接
+				ReadAwaiter* reader = nullptr;
+				std::coroutine_handle<> drainer;
+				bool closed = false;
+
+				void onConnection(const TcpConnectionPtr& c);
+				void onMessage(Buffer* buf);
+				void onWriteComplete();
+			};
+
+			CoConnection(const TcpConnectionPtr& conn, std::shared_ptr<TcpClient> client);
+
+			std::shared_ptr<State> state_;
+		};
+
+		class CoConnection::ReadAwaiter
+		{
+		public:
+			ReadAwaiter(State* state, size_t n, const StringPiece& delim)
+				: state_(state), n_(n), delim_(delim), scanned_(0)
+			{
+			}
+
+			bool await_ready() { return tryRead(state_->conn->inputBuffer()); }
+			void await_suspend(std::coroutine_handle<> handle) noexcept
+			{
+				assert(!state_->reader);
+				handle_ = handle;
+				state_->reader = this;
+			}
+			string await_resume() { return std::move(result_); }
+
+		private:
+			friend struct State;
+
+			// 数据够了就取出，连接关闭时取出剩下的
+			bool tryRead(Buffer* buf)
+			{
+				if (delim_.empty())
+				{
+					if (buf->readableBytes() >= n_ || state_->closed)
+					{
+						result_ = buf->retrieveAsString(std::min(n_, buf->readableBytes()));
+						return true;
+					}
+					return false;
+				}
+				// 从上次找过的位置接着找
+				const size_t delimSize = static_cast<size_t>(delim_.size());
+				const char* start = buf->peek() + scanned_;
+				const char* end = buf->beginWrite();
+				const char* found = std::search(start, end, delim_.begin(), delim_.end());
+				if (found != end)
+				{
+					result_ = buf->retrieveAsString(static_cast<size_t>(found - buf->peek()) + delimSize);
+					return true;
+				}
+				const size_t searched = buf->readableBytes();
+				scanned_ = searched >= delimSize ? searched - delimSize + 1 : 0;
+				return state_->closed;
+			}
+
+			State* state_;
+			size_t n_;
+			StringPiece delim_;	// 指向调用者的字符串，在co_await期间有效
+			size_t scanned_;
+			string result_;
+			std::coroutine_handle<> handle_;
+		};
+
+		inline CoConnection::ReadAwaiter CoConnection::read(size_t n)
+		{
+			return ReadAwaiter(state_.get(), n, StringPiece());
+		}
+
+		inline CoConnection::ReadAwaiter CoConnection::readUntil(const StringPiece& delim)
+		{
+			assert(!delim.empty());
+			return ReadAwaiter(state_.get(), 0, delim);
+		}
+
+		inline CoConnection::CoConnection(const TcpConnectionPtr& conn, std::shared_ptr<TcpClient> client)
+			: state_(std::make_shared<State>())
+		{
+			conn->getLoop()->assertInLoopThread();
+			state_->conn = conn;
+			state_->client = std::move(client);
+			state_->closed = !conn->connected();
+			// 回调只持有weak_ptr，协程结束后连接上的事件不再处理
+			std::weak_ptr<State> weak(state_);
+			conn->setConnectionCallback([weak](const TcpConnectionPtr& c) {
+				if (std::shared_ptr<State> state = weak.lock())
+				{
+					state->onConnection(c);
+				}
+			});
+			conn->setMessageCallback([weak](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+				if (std::shared_ptr<State> state = weak.lock())
+				{
+					state->onMessage(buf);
+				}
+			});
+			conn->setWriteCompleteCallback([weak](const TcpConnectionPtr&) {
+				if (std::shared_ptr<State> state = weak.lock())
+				{
+					state->onWriteComplete();
+				}
+			});
+		}
+
+		inline void CoConnection::State::onConnection(const TcpConnectionPtr& c)
+		{
+			if (c->connected())
+			{
+				return;
+			}
+			// 连接断开，唤醒所有等待者
+			closed = true;
+			if (reader)
+			{
+				ReadAwaiter* r = std::exchange(reader, nullptr);
+				r->tryRead(conn->inputBuffer());
+				r->handle_.resume();
+			}
+			if (drainer)
+			{
+				std::exchange(drainer, nullptr).resume();
+			}
+		}
+
+		inline void CoConnection::State::onMessage(Buffer* buf)
+		{
+			if (reader && reader->tryRead(buf))
+			{
+				std::exchange(reader, nullptr)->handle_.resume();
+			}
+		}
+
+		inline void CoConnection::State::onWriteComplete()
+		{
+			if (drainer && conn->outputBuffer()->empty())
+			{
+				std::exchange(drainer, nullptr).resume();
+			}
+		}
+
+		/// Awaiter of connectTo().
+		class ConnectAwaiter
+		{
+		public:
+			ConnectAwaiter(EventLoop* loop, const InetAddress& serverAddr, const string& name)
+				: client_(std::make_shared<TcpClient>(loop, serverAddr, name))
+			{
+			}
+
+			bool await_ready() noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				client_->getLoop()->assertInLoopThread();
+				handle_ = handle;
+				client_->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+					if (conn->connected())
+					{
+						conn_ = conn;
+						handle_.resume();
+					}
+				});
+				client_->connect();
+			}
+			CoConnection await_resume()
+			{
+				// 之后的事件由CoConnection处理，this即将失效
+				client_->setConnectionCallback(defaultConnectionCallback);
+				return CoConnection(conn_, std::move(client_));
+			}
+
+		private:
+			std::shared_ptr<TcpClient> client_;
+			TcpConnectionPtr conn_;
+			std::coroutine_handle<> handle_;
+		};
+
+		/// Connects to serverAddr, retrying like TcpClient until it succeeds.
+		/// The TcpClient lives as long as the returned CoConnection.
+		/// Call it in the loop thread.
+		inline ConnectAwaiter connectTo(EventLoop* loop, const InetAddress& serverAddr, const string& name)
+		{
+			return ConnectAwaiter(loop, serverAddr, name);
+		}
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_COROUTINE_H
@@ -2,8 +2,10 @@
 #include "muduo/net/EventLoop.h"
 
 #include "muduo/base/Logging.h"
-#include "muduo/base/Mutex.h"
+#include "muduo/base/ThreadLocalSingleton.h"
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/IdleWheel.h"
 #include "muduo/net/Poller.h"
 #include "muduo/net/SocketsOps.h"
 #include "muduo/net/TimerQueue.h"
@@ -24,6 +26,8 @@ namespace
 	__thread EventLoop* t_loopInThisThread = 0;
 
 	const int kPollTimeMs = 10000;
+	// freeFunctorNodes_最多留这么多节点，突发过后多出来的释放掉，生产者每次取走的也不超过它
+	const size_t kMaxFreeFunctorNodes = 4096;
 
 	int createEventfd()
 	{
@@ -65,11 +69,26 @@ EventLoop::EventLoop()
 	callingPendingFunctors_(false),
 	iteration_(0),
 	threadId_(CurrentThread::tid()),//当我们创建该对象时，我们就把该线程的ID进行缓存起来
+	busyPollUs_(0),
+	timerSlack_(0.0),
+	spinning_(false),
+	busyPollSpins_(0),
+	busyPollMicroseconds_(0),
+	busyPollHits_(0),
+	numConnections_(0),
+	loadWindowStart_(Timestamp::now()),
+	windowBusyUs_(0),
+	recentBusyUs_(0),
 	poller_(Poller::newDefaultPoller(this)),//创建轮询器对象
 	timerQueue_(new TimerQueue(this)),
+	bufferPool_(new BufferPool),
 	wakeupFd_(createEventfd()),// 创建唤醒文件描述符eventfd
 	wakeupChannel_(new Channel(this, wakeupFd_)),//创建一个通道，把wakeupFd传入
-	currentActiveChannel_(NULL)
+	currentActiveChannel_(NULL),
+	freeFunctorNodes_(NULL),
+	numFreeFunctorNodes_(0),
+	numPendingFunctors_(0),
+	sleeping_(false)
 {
 	LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
 	//判断t_loopInThisThread，确保每个线程只有一个eventloop对象
@@ -100,6 +119,18 @@ EventLoop::~EventLoop()
 	wakeupChannel_->disableAll();
 	wakeupChannel_->remove();
 	::close(wakeupFd_);
+	// loop()返回之后加入的回调，不执行，直接销毁
+	while (FunctorNode* node = pendingFunctors_.pop())
+	{
+		delete node;
+	}
+	FunctorNode* node = freeFunctorNodes_.exchange(NULL, std::memory_order_acquire);
+	while (node)
+	{
+		FunctorNode* next = node->next.load(std::memory_order_relaxed);
+		delete node;
+		node = next;
+	}
 	//析构的时候要把EventLoop指针置为NULL
 	t_loopInThisThread = NULL;
 }
@@ -113,7 +144,9 @@ void EventLoop::loop()
 	assertInLoopThread();
 	//开始事件循环，looping设为true
 	looping_ = true;
-	quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
+	// 不在这里清除quit_，loop()之前的quit()也有效，
+	// 否则EventLoopThread刚启动就析构时线程会一直等下去。
+	// 代价是loop()返回之后多余的quit()也会留到下一次loop()，它不poll就返回
 	LOG_TRACE << "EventLoop " << this << " start looping";
 
 	while (!quit_)
@@ -121,8 +154,14 @@ void EventLoop::loop()
 		//第一步:清除活动通道
 		activeChannels_.clear();
 		//第二步:调用poll，返回活动的通道activeChannels_
-		pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+		const Timestamp lastPollReturn = pollReturnTime_;
+		pollReturnTime_ = poller_->poll(pollTimeout(), &activeChannels_);
+		sleeping_.store(false, std::memory_order_relaxed);
 		++iteration_;
+		if (busyPollUs_ > 0)
+		{
+			updateBusyPoll(lastPollReturn);
+		}
 		if (Logger::logLevel() <= Logger::TRACE)
 		{
 			//打印活动通道，其实实在进行日志的登记
@@ -138,14 +177,27 @@ void EventLoop::loop()
 			// 处理事件
 			currentActiveChannel_->handleEvent(pollReturnTime_);
 		}
+		if (!timerQueue_->useTimerfd())
+		{
+			// 没有timerfd，在这里处理到期的定时器
+			timerQueue_->expire(pollReturnTime_);
+		}
 		// 处理完后把当前正在处理通道置为NULL
 		currentActiveChannel_ = NULL;
 		eventHandling_ = false;
 		// 运行等待(未决)函数
 		doPendingFunctors();
+		updateLoad();
 	}
 
+	// 看到quit_之前加入的回调再执行一遍，比如TcpServer析构前排队的connectDestroyed()，
+	// 否则它们随EventLoop析构，连接的通道还在Poller中。
+	// 只执行一遍，doPendingFunctors()只执行到开始时的最后一个，执行中再加入的不执行，
+	// 否则自己再加入自己的回调，或者别的线程一直在加入，loop()就不会返回
+	doPendingFunctors();
+
 	LOG_TRACE << "EventLoop " << this << " stop looping";
+	quit_ = false;	// 可以再次loop()，返回之后的quit()对下一次有效
 	looping_ = false;
 }
 
@@ -184,45 +236,182 @@ void EventLoop::runInLoop(Functor cb)
 //将任务添加到循环队列中
 void EventLoop::queueInLoop(Functor cb)
 {
+	FunctorNode* node = newFunctorNode();
+	node->functor = std::move(cb);
+	numPendingFunctors_.fetch_add(1, std::memory_order_relaxed);
+	pendingFunctors_.push(node);
+
+	// 只有IO线程阻塞在poll中才需要唤醒，并且只由第一个生产者写eventfd
+	// IO线程自己queueInLoop时不会在睡眠，下一次poll前会看到队列非空
+	if (sleeping_.load(std::memory_order_seq_cst)
+		&& sleeping_.exchange(false, std::memory_order_seq_cst))
 	{
-		//使用互斥锁进行保护
-		MutexLockGuard lock(mutex_);
-		pendingFunctors_.push_back(std::move(cb));
+		wakeup();
 	}
+}
 
-	//调用queueInLoop的线程不是当前IO线程，为了及时的调用，需要唤醒
-	//或者调用queueInLoop的线程是当前IO线程，并且此时正在调用PendingFunctor，需要唤醒
-	//只有当前IO线程的事件回调中调用queueInLoop才不需要唤醒
-	if (!isInLoopThread() || callingPendingFunctors_)
+// 每个线程缓存从EventLoop取来的空闲节点，用完才再取，最多kMaxFreeFunctorNodes个，线程结束时释放
+struct EventLoop::FunctorNodeCache : noncopyable
+{
+	FunctorNode* head = NULL;
+
+	~FunctorNodeCache()
 	{
-		wakeup();
+		while (head)
+		{
+			FunctorNode* next = head->next.load(std::memory_order_relaxed);
+			delete head;
+			head = next;
+		}
+	}
+};
+
+// 稳定后queueInLoop()不再分配内存：节点执行完由IO线程放回freeFunctorNodes_，
+// 生产者缓存用完时用一次交换整串取走。只有IO线程逐个放回、生产者只整串取走，没有ABA问题
+EventLoop::FunctorNode* EventLoop::newFunctorNode()
+{
+	FunctorNodeCache& cache = ThreadLocalSingleton<FunctorNodeCache>::instance();
+	if (!cache.head)
+	{
+		cache.head = freeFunctorNodes_.exchange(NULL, std::memory_order_acquire);
+	}
+	FunctorNode* node = cache.head;
+	if (node)
+	{
+		cache.head = node->next.load(std::memory_order_relaxed);
+		return node;
+	}
+	return new FunctorNode;
+}
+
+// 只在IO线程中调用
+void EventLoop::recycleFunctorNode(FunctorNode* node)
+{
+	node->functor = Functor();	// 及时释放回调绑定的对象
+	FunctorNode* head = freeFunctorNodes_.load(std::memory_order_relaxed);
+	if (head && numFreeFunctorNodes_ >= kMaxFreeFunctorNodes)
+	{
+		delete node;
+		return;
 	}
+	do
+	{
+		// 生产者只整串取走，头为空说明之前放回的都被取走了
+		if (!head)
+		{
+			numFreeFunctorNodes_ = 0;
+		}
+		node->next.store(head, std::memory_order_relaxed);
+	} while (!freeFunctorNodes_.compare_exchange_weak(head, node,
+		std::memory_order_release, std::memory_order_relaxed));
+	++numFreeFunctorNodes_;
 }
 
 size_t EventLoop::queueSize() const
 {
-	MutexLockGuard lock(mutex_);
-	return pendingFunctors_.size();
+	return numPendingFunctors_.load(std::memory_order_relaxed);
+}
+
+// 先声明要睡眠，再检查队列，与queueInLoop()中先push再检查sleeping_配对，
+// 两边至少有一边能看到对方，不会丢失唤醒
+int EventLoop::pollTimeout()
+{
+	// 忙轮询时不置睡眠标志，queueInLoop()不写eventfd，由下一次poll之后的doPendingFunctors()取走
+	if (spinning_ && busyPollUs_ > 0)
+	{
+		return 0;
+	}
+	sleeping_.store(true, std::memory_order_seq_cst);
+	if (!pendingFunctors_.empty())
+	{
+		sleeping_.store(false, std::memory_order_relaxed);
+		return 0;
+	}
+	if (!timerQueue_->useTimerfd())
+	{
+		return timerQueue_->pollTimeout(Timestamp::now(), kPollTimeMs);
+	}
+	return kPollTimeMs;
+}
+
+void EventLoop::updateBusyPoll(Timestamp lastPollReturn)
+{
+	const bool idle = activeChannels_.empty() && pendingFunctors_.empty();
+	if (spinning_)
+	{
+		if (idle)
+		{
+			++busyPollSpins_;
+			busyPollMicroseconds_ += pollReturnTime_.microSecondsSinceEpoch()
+				- lastPollReturn.microSecondsSinceEpoch();
+		}
+		else
+		{
+			++busyPollHits_;
+		}
+	}
+	if (!idle)
+	{
+		lastBusy_ = pollReturnTime_;
+	}
+	spinning_ = pollReturnTime_.microSecondsSinceEpoch()
+		- lastBusy_.microSecondsSinceEpoch() < busyPollUs_;
+}
+
+void EventLoop::updateLoad()
+{
+	const int64_t kLoadWindowUs = 1000 * 1000;
+	const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+	windowBusyUs_ += now - pollReturnTime_.microSecondsSinceEpoch();
+	const int64_t elapsed = now - loadWindowStart_.microSecondsSinceEpoch();
+	if (elapsed >= kLoadWindowUs)
+	{
+		// 折算成每秒的忙碌时间，长时间阻塞在poll中的窗口也能比较
+		recentBusyUs_.store(windowBusyUs_ * kLoadWindowUs / elapsed, std::memory_order_relaxed);
+		windowBusyUs_ = 0;
+		loadWindowStart_ = Timestamp(now);
+	}
+}
+
+void EventLoop::runAtEndOfIteration(Functor cb)
+{
+	assertInLoopThread();
+	endOfIterationFunctors_.push_back(std::move(cb));
 }
 
 //在某一时刻运行定时器
 TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 {
-	return timerQueue_->addTimer(std::move(cb), time, 0.0);
+	return runAt(time, std::move(cb), timerSlack());
 }
 
 //过一段时间运行定时器
 TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
-	Timestamp time(addTime(Timestamp::now(), delay));
-	return runAt(time, std::move(cb));
+	return runAfter(delay, std::move(cb), timerSlack());
 }
 
 //每隔一段时间运行定时器
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+	return runEvery(interval, std::move(cb), timerSlack());
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb, double slack)
+{
+	return timerQueue_->addTimer(std::move(cb), time, 0.0, slack);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb, double slack)
+{
+	Timestamp time(addTime(Timestamp::now(), delay));
+	return runAt(time, std::move(cb), slack);
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb, double slack)
 {
 	Timestamp time(addTime(Timestamp::now(), interval));
-	return timerQueue_->addTimer(std::move(cb), time, interval);
+	return timerQueue_->addTimer(std::move(cb), time, interval, slack);
 }
 
 void EventLoop::cancel(TimerId timerId)
@@ -230,6 +419,31 @@ void EventLoop::cancel(TimerId timerId)
 	return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::setUseTimerfd(bool on)
+{
+	timerQueue_->setUseTimerfd(on);
+}
+
+bool EventLoop::useTimerfd() const
+{
+	return timerQueue_->useTimerfd();
+}
+
+int64_t EventLoop::timerArms() const
+{
+	return timerQueue_->numArms();
+}
+
+IdleWheel* EventLoop::idleWheel()
+{
+	assertInLoopThread();
+	if (!idleWheel_)
+	{
+		idleWheel_.reset(new IdleWheel(this));
+	}
+	return idleWheel_.get();
+}
+
 void EventLoop::updateChannel(Channel* channel)
 {
 	// channel 所处的Loop必须是当前EventLoop对象
@@ -289,17 +503,35 @@ void EventLoop::handleRead()
 //运行等待任务
 void EventLoop::doPendingFunctors()
 {
-	std::vector<Functor> functors;
 	callingPendingFunctors_ = true;
 
+	// 只执行到开始时的最后一个，执行中新加入的留到下一轮，避免回调不断加入导致饿死IO
+	const FunctorNode* last = pendingFunctors_.back();
+	if (!pendingFunctors_.empty())
 	{
-		MutexLockGuard lock(mutex_);
-		functors.swap(pendingFunctors_);
+		while (FunctorNode* node = pendingFunctors_.pop())
+		{
+			numPendingFunctors_.fetch_sub(1, std::memory_order_relaxed);
+			const bool done = node == last;
+			node->functor();
+			recycleFunctorNode(node);
+			if (done)
+			{
+				break;
+			}
+		}
 	}
 
-	for (const Functor& functor : functors)
+	// 本轮循环的最后一步，此时queueInLoop()加入的回调留到下一轮执行
+	std::vector<Functor> functors;
+	while (!endOfIterationFunctors_.empty())
 	{
-		functor();
+		functors.clear();
+		functors.swap(endOfIterationFunctors_);
+		for (const Functor& functor : functors)
+		{
+			functor();
+		}
 	}
 	callingPendingFunctors_ = false;
 }
@@ -7,8 +7,8 @@
 
 #include <boost/any.hpp>
 
-#include "muduo/base/Mutex.h"
 #include "muduo/base/CurrentThread.h"
+#include "muduo/base/MpscQueue.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/TimerId.h"
@@ -18,6 +18,8 @@ namespace muduo
 	namespace net
 	{
 		//前项声明class Channel;class Poller;class Channel;
+		class BufferPool;
+		class IdleWheel;
 		class Poller;
 		class TimerQueue;
 
@@ -31,17 +33,29 @@ namespace muduo
 			typedef std::function<void()> Functor;
 
 			EventLoop();
+			/// Destroys the callbacks still queued without running them, they
+			/// were queued after loop() returned, see queueInLoop().
 			~EventLoop();  // force out-line dtor, for std::unique_ptr members.
 
 			///
 			/// Loops forever.
 			///
 			/// Must be called in the same thread as creation of the object.
+			/// Returns without polling if quit() was called before, and may be
+			/// called again after it returns.
+			/// A quit() made after a loop() returned is kept the same way: the
+			/// next loop() returns at once, don't quit() a loop that isn't
+			/// meant to stop.
+			/// Before returning it runs once more the callbacks queued until then,
+			/// those they queue in turn are left in the queue, see queueInLoop().
 			///
 			void loop();
 
 			/// Quits loop.
 			///
+			/// Takes effect at the end of the current iteration, or at once on
+			/// the next loop() if the loop isn't running, also when loop() has
+			/// already returned.
 			/// This is not 100% thread safe, if you call through a raw pointer,
 			/// better to call through shared_ptr<EventLoop> for 100% safety.
 			void quit();
@@ -53,6 +67,29 @@ namespace muduo
 
 			int64_t iteration() const { return iteration_; }
 
+			/// Busy polling, trades a core for wakeup latency.
+			/// After any activity the loop keeps polling with zero timeout for
+			/// @c microseconds before it blocks again, 0 (default) disables.
+			/// Call before loop() or in the loop thread.
+			void setBusyPoll(int microseconds) { busyPollUs_ = microseconds; }
+			int busyPoll() const { return busyPollUs_; }
+
+			/// Zero timeout polls which found nothing to do.
+			int64_t busyPollSpins() const { return busyPollSpins_; }
+			/// Time spent in those polls.
+			int64_t busyPollMicroseconds() const { return busyPollMicroseconds_; }
+			/// Zero timeout polls which found events or queued callbacks.
+			int64_t busyPollHits() const { return busyPollHits_; }
+
+			/// Connections owned by this loop, including the ones being set up.
+			/// Safe to call from other threads.
+			int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+			/// Time spent handling events and callbacks, in microseconds per
+			/// second, averaged over the last completed window of about one second.
+			/// An idle loop updates it when poll times out, at most 10 seconds late.
+			/// Safe to call from other threads.
+			int64_t recentBusyMicroseconds() const { return recentBusyUs_.load(std::memory_order_relaxed); }
+
 			/// Runs callback immediately in the loop thread.
 			/// It wakes up the loop, and run the cb.
 			/// If in the same loop thread, cb is run within the function.
@@ -64,11 +101,25 @@ namespace muduo
 			void runInLoop(Functor cb);
 			/// Queues callback in the loop thread.
 			/// Runs after finish pooling.
-			/// Safe to call from other threads.
+			/// Safe to call from other threads, lock free. The eventfd is written
+			/// at most once per poll, only when the loop is blocked in it.
+			/// At shutdown: cb runs in the loop thread if queued before the last
+			/// pass of loop() over the queue, which starts after quit() is seen.
+			/// If queued later, including by the callbacks of that pass, it runs
+			/// in the next loop(), or is destroyed unrun by ~EventLoop(), in the
+			/// thread destroying the loop.
+			/// To have it run, stop the threads queueing before quit().
 			void queueInLoop(Functor cb);
 
+			/// Approximate when called from other threads.
 			size_t queueSize() const;
 
+			/// Runs callback once at the end of this iteration, after the active
+			/// channels and the queued callbacks are handled, before polling again.
+			/// Must be called in the loop thread.
+			// 用于合并同一轮循环中的多次发送
+			void runAtEndOfIteration(Functor cb);
+
 			// timers
 
 			///
@@ -87,16 +138,48 @@ namespace muduo
 			//每隔一段时间运行定时器
 			TimerId runEvery(double interval, TimerCallback cb);
 			///
+			/// Same as above, the callback may run up to @c slack seconds late,
+			/// so that nearby timers share one wakeup.
+			/// Safe to call from other threads.
+			TimerId runAt(Timestamp time, TimerCallback cb, double slack);
+			TimerId runAfter(double delay, TimerCallback cb, double slack);
+			TimerId runEvery(double interval, TimerCallback cb, double slack);
+			///
 			/// Cancels the timer.
 			/// Safe to call from other threads.
 			//取消定时器
 			void cancel(TimerId timerId);
 
+			/// Default slack in seconds of the timers added without one, 0 by default.
+			/// Timers added before the call keep theirs.
+			/// Safe to call from other threads, like the runAt() family reading it.
+			void setTimerSlack(double seconds) { timerSlack_.store(seconds, std::memory_order_relaxed); }
+			double timerSlack() const { return timerSlack_.load(std::memory_order_relaxed); }
+
+			/// Wakes up for timers with the poll timeout instead of a timerfd,
+			/// which saves a timerfd_settime() each time the next expiration
+			/// changes. Timers stay at millisecond granularity.
+			/// Must be called in the loop thread.
+			void setUseTimerfd(bool on);
+			bool useTimerfd() const;
+			/// Times the wakeup for timers was set.
+			/// Safe to call from other threads.
+			int64_t timerArms() const;
+
+			/// Buffer storage shared by the connections of this loop.
+			/// Must be used in the loop thread.
+			BufferPool* bufferPool() { return bufferPool_.get(); }
+
+			/// Idle timeouts of the connections of this loop, created on first use.
+			/// Internal use only, see TcpConnection::setIdleTimeout().
+			IdleWheel* idleWheel();
+
 			// internal usage
 			void wakeup();//唤醒
 			void updateChannel(Channel* channel);/*在Poller中添加或者更新通道*/
 			void removeChannel(Channel* channel);/*从Poller中移除通道*/
 			bool hasChannel(Channel* channel);
+			void adjustConnections(int delta) { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
 
 			// pid_t threadId() const { return threadId_; }
 			void assertInLoopThread()
@@ -133,6 +216,9 @@ namespace muduo
 			void abortNotInLoopThread();
 			void handleRead();  // waked up
 			void doPendingFunctors();
+			int pollTimeout();
+			void updateBusyPoll(Timestamp lastPollReturn);
+			void updateLoad();
 
 			void printActiveChannels() const; // DEBUG
 
@@ -145,8 +231,21 @@ namespace muduo
 			int64_t iteration_;
 			const pid_t threadId_;//当前对象所属线程ID
 			Timestamp pollReturnTime_;/*调用poll函数时返回的时间戳*/
+			int busyPollUs_;
+			std::atomic<double> timerSlack_;	// 跨线程的runAt()等读取
+			bool spinning_;	// 下一次poll不阻塞
+			Timestamp lastBusy_;	// 最近一次有事件或回调的时间
+			int64_t busyPollSpins_;
+			int64_t busyPollMicroseconds_;
+			int64_t busyPollHits_;
+			std::atomic<int> numConnections_;
+			Timestamp loadWindowStart_;
+			int64_t windowBusyUs_;	// 当前窗口内处理事件的时间
+			std::atomic<int64_t> recentBusyUs_;
 			std::unique_ptr<Poller> poller_;/*poller的生存期由EventLoop控制*/
 			std::unique_ptr<TimerQueue> timerQueue_;
+			std::unique_ptr<BufferPool> bufferPool_;	// 本线程连接的缓冲区内存池
+			std::unique_ptr<IdleWheel> idleWheel_;
 
 			//唤醒文件描述符，用于事件的通知，是eventfd()所创建的文件描述符
 			//用于线程或进程间的通信
@@ -164,8 +263,22 @@ namespace muduo
 			ChannelList activeChannels_;/*Channel返回的活动事件的通道*/
 			Channel* currentActiveChannel_;/*当前正在处理的活动通道*/
 
-			mutable MutexLock mutex_;
-			std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+			struct FunctorNode
+			{
+				std::atomic<FunctorNode*> next;
+				Functor functor;
+			};
+			struct FunctorNodeCache;
+
+			FunctorNode* newFunctorNode();
+			void recycleFunctorNode(FunctorNode* node);
+
+			MpscQueue<FunctorNode> pendingFunctors_;
+			std::atomic<FunctorNode*> freeFunctorNodes_;	// 执行完的节点，生产者整串取走重用
+			size_t numFreeFunctorNodes_;	// freeFunctorNodes_的长度，只在IO线程中访问，被取走时不准，只会偏大
+			std::atomic<size_t> numPendingFunctors_;
+			std::atomic<bool> sleeping_;	// 阻塞在poll中，queueInLoop()要写eventfd唤醒
+			std::vector<Functor> endOfIterationFunctors_;	// 只在IO线程中访问，不加锁
 		};
 
 	}  // namespace net
@@ -1,7 +1,13 @@
 ﻿#include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -12,7 +18,9 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
 	thread_(std::bind(&EventLoopThread::threadFunc, this), name), //初始化线程函数
 	mutex_(),//初始化mutex
 	cond_(mutex_),//条件变量要跟一个mutex一起配合使用
-	callback_(cb)
+	callback_(cb),
+	cpu_(-1),
+	numaLocal_(false)
 {
 }
 
@@ -28,9 +36,20 @@ EventLoopThread::~EventLoopThread()
 
 //启动线程，并且这个线程成为了IO线程
 EventLoop* EventLoopThread::startLoop()
+{
+	start();
+	return waitForLoop();
+}
+
+void EventLoopThread::start()
 {
 	assert(!thread_.started());//断言判断这个线程还没有启动
 	thread_.start();//启动线程
+}
+
+EventLoop* EventLoopThread::waitForLoop()
+{
+	assert(thread_.started());
 	//当这个线程启动后，就调用回调函数，就是EventLoopThread::threadFunc
 	//所以有两个线程在运行：1个是startLoop()，一个是threadFunc()
 	//这两个线程的运行顺序是不缺定的，
@@ -49,8 +68,28 @@ EventLoop* EventLoopThread::startLoop()
 	return loop;
 }
 
+// 在创建EventLoop之前绑定CPU和内存策略，poller和缓冲区都分配在本地节点上
+void EventLoopThread::setPlacement()
+{
+	if (cpu_ >= 0)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu_, &cpus);
+		if (::sched_setaffinity(0, sizeof cpus, &cpus) < 0)
+		{
+			LOG_SYSERR << "EventLoopThread::setPlacement cpu " << cpu_;
+		}
+	}
+	if (numaLocal_ && ::syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0) < 0)
+	{
+		LOG_SYSERR << "EventLoopThread::setPlacement set_mempolicy";
+	}
+}
+
 void EventLoopThread::threadFunc()
 {
+	setPlacement();
 	EventLoop loop;
 
 	//如果在创建EventLoopThread对象时，传入了一个callback_
@@ -25,8 +25,22 @@ namespace muduo
 			~EventLoopThread();
 			EventLoop* startLoop(); //启动线程，该线程就成为了IO线程
 
+			/// startLoop() in two steps, so that several threads can start at once.
+			void start();
+			EventLoop* waitForLoop();
+
+			/// Pins the thread to cpu before the loop is created, the memory the
+			/// loop touches first is then allocated on the node of cpu.
+			/// -1 (default) lets it run on any CPU. Call before start().
+			void setCpu(int cpu) { cpu_ = cpu; }
+			int cpu() const { return cpu_; }
+			/// Allocates the memory of the thread on the node it runs on, overriding
+			/// a process wide policy such as numactl --interleave. Call before start().
+			void setNumaLocal(bool on) { numaLocal_ = on; }
+
 		private:
 			void threadFunc();//线程函数
+			void setPlacement();
 
 			EventLoop* loop_ GUARDED_BY(mutex_);//指向一个EventLoop对象,一个IO线程有且只有一个EventLoop对象
 			bool exiting_;
@@ -34,6 +48,8 @@ namespace muduo
 			MutexLock mutex_;
 			Condition cond_ GUARDED_BY(mutex_);
 			ThreadInitCallback callback_;//回调函数在EventLoop;:loop事件循环之前被调用
+			int cpu_;
+			bool numaLocal_;
 		};
 
 	}  // namespace net
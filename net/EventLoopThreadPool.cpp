@@ -11,17 +11,49 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/Timestamp.h"
+
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+	// æµʱ1%loopһæٱȽ
+	const int64_t kBusyGranularityUs = 10 * 1000;
+
+	bool lessConnections(EventLoop* a, EventLoop* b)
+	{
+		return a->numConnections() < b->numConnections();
+	}
+
+	bool lessBusy(EventLoop* a, EventLoop* b)
+	{
+		int64_t busyA = a->recentBusyMicroseconds() / kBusyGranularityUs;
+		int64_t busyB = b->recentBusyMicroseconds() / kBusyGranularityUs;
+		return busyA < busyB || (busyA == busyB && lessConnections(a, b));
+	}
+
+	bool lessLoaded(EventLoop* a, EventLoop* b)
+	{
+		int connA = a->numConnections();
+		int connB = b->numConnections();
+		return connA < connB
+			|| (connA == connB && a->recentBusyMicroseconds() < b->recentBusyMicroseconds());
+	}
+}
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg)
 	: baseLoop_(baseLoop),
 	name_(nameArg),
 	started_(false),
 	numThreads_(0),
-	next_(0)
+	next_(0),
+	numaLocal_(false),
+	parallelStart_(false),
+	selection_(kRoundRobin),
+	seed_(static_cast<uint32_t>(Timestamp::now().microSecondsSinceEpoch()) | 1)
 {
 }
 
@@ -43,8 +75,44 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 		char buf[name_.size() + 32];
 		snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
 		EventLoopThread* t = new EventLoopThread(cb, buf);	//һ߳
+		if (!cpus_.empty())
+		{
+			t->setCpu(cpus_[i % cpus_.size()]);
+		}
+		t->setNumaLocal(numaLocal_);
 		threads_.push_back(std::unique_ptr<EventLoopThread>(t));	// ߳ѹEventLoop
-		loops_.push_back(t->startLoop());	// EventLoopThreaḍ߳ڽ¼ѭ֮ǰcb
+		if (parallelStart_)
+		{
+			t->start();	// ȫȴ
+		}
+		else
+		{
+			loops_.push_back(t->startLoop());	// EventLoopThreaḍ߳ڽ¼ѭ֮ǰcb
+		}
+	}
+	if (parallelStart_)
+	{
+		for (const auto& t : threads_)
+		{
+			loops_.push_back(t->waitForLoop());
+		}
+	}
+
+	for (size_t i = 0; i < threads_.size(); ++i)
+	{
+		int cpu = threads_[i]->cpu();
+		if (cpu >= 0)
+		{
+			if (static_cast<size_t>(cpu) >= loopOfCpu_.size())
+			{
+				loopOfCpu_.resize(cpu + 1);
+			}
+			// ̰߳ͬһCPUʱȡһ
+			if (loopOfCpu_[cpu] == NULL)
+			{
+				loopOfCpu_[cpu] = loops_[i];
+			}
+		}
 	}
 
 	// numThreads_ == 0˵ûдЩIỌ߳cbΪգôҲһcb
@@ -55,11 +123,40 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 	}
 }
 
+void EventLoopThreadPool::setLoopSelection(LoopSelection selection)
+{
+	selection_ = selection;
+	switch (selection)
+	{
+	case kRoundRobin:
+		selector_ = LoopSelector();
+		break;
+	case kLeastConnections:
+		selector_ = std::bind(&EventLoopThreadPool::getLeastConnections, this);
+		break;
+	case kLeastBusy:
+		selector_ = std::bind(&EventLoopThreadPool::getLeastBusy, this);
+		break;
+	case kPowerOfTwoChoices:
+		selector_ = std::bind(&EventLoopThreadPool::getPowerOfTwoChoices, this);
+		break;
+	}
+}
+
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
 	// жǷڵǰ߳
 	baseLoop_->assertInLoopThread();
 	assert(started_);
+	if (selector_ && !loops_.empty())
+	{
+		return selector_(loops_);
+	}
+	return getRoundRobin();
+}
+
+EventLoop* EventLoopThreadPool::getRoundRobin()
+{
 	EventLoop* loop = baseLoop_;	// ȰloopָָbaseLoop_loopָacceptorReactorҲMainReactor
 
 	// loops_ΪգloopָbaseLoop
@@ -81,6 +178,54 @@ EventLoop* EventLoopThreadPool::getNextLoop()
 	return loop;
 }
 
+// ͬʱֽеλÿʼңѡеһ
+EventLoop* EventLoopThreadPool::getLeastConnections()
+{
+	EventLoop* best = getRoundRobin();
+	for (EventLoop* loop : loops_)
+	{
+		if (lessConnections(loop, best))
+		{
+			best = loop;
+		}
+	}
+	return best;
+}
+
+EventLoop* EventLoopThreadPool::getLeastBusy()
+{
+	EventLoop* best = getRoundRobin();
+	for (EventLoop* loop : loops_)
+	{
+		if (lessBusy(loop, best))
+		{
+			best = loop;
+		}
+	}
+	return best;
+}
+
+EventLoop* EventLoopThreadPool::getPowerOfTwoChoices()
+{
+	size_t n = loops_.size();
+	if (n == 1)
+	{
+		return loops_[0];
+	}
+	size_t i = random() % n;
+	size_t j = (i + 1 + random() % (n - 1)) % n;	// iͬ
+	return lessLoaded(loops_[j], loops_[i]) ? loops_[j] : loops_[i];
+}
+
+// xorshift32
+uint32_t EventLoopThreadPool::random()
+{
+	seed_ ^= seed_ << 13;
+	seed_ ^= seed_ >> 17;
+	seed_ ^= seed_ << 5;
+	return seed_;
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
 	baseLoop_->assertInLoopThread();
@@ -93,6 +238,16 @@ EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 	return loop;
 }
 
+EventLoop* EventLoopThreadPool::getLoopForCpu(int cpu)
+{
+	baseLoop_->assertInLoopThread();
+	if (cpu >= 0 && static_cast<size_t>(cpu) < loopOfCpu_.size())
+	{
+		return loopOfCpu_[cpu];
+	}
+	return NULL;
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
 	baseLoop_->assertInLoopThread();
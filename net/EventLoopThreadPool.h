@@ -24,19 +24,55 @@ namespace muduo
 		{
 		public:
 			typedef std::function<void(EventLoop*)> ThreadInitCallback;
+			/// Picks one of the loops, which is never empty, for a new connection.
+			typedef std::function<EventLoop*(const std::vector<EventLoop*>&)> LoopSelector;
+
+			/// How getNextLoop() spreads connections.
+			enum LoopSelection
+			{
+				kRoundRobin,
+				/// Fewest connections, EventLoop::numConnections().
+				kLeastConnections,
+				/// Least EventLoop::recentBusyMicroseconds(), loops within 1% of a
+				/// second are compared by connections. The measurement lags by up
+				/// to a second, so a burst of connections goes to the same loop.
+				kLeastBusy,
+				/// The less loaded of two random loops, by connections then busy
+				/// time. Avoids sending a burst to one loop.
+				kPowerOfTwoChoices,
+			};
 
 			EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
 			~EventLoopThreadPool();
 			void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+			int numThreads() const { return numThreads_; }
+			/// Pins thread i to cpus[i % cpus.size()], see EventLoopThread::setCpu(),
+			/// a negative entry leaves that thread unpinned. Call before start().
+			void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+			/// See EventLoopThread::setNumaLocal(). Call before start().
+			void setNumaLocal(bool on) { numaLocal_ = on; }
+			/// Starts all threads at once instead of one after another, the
+			/// ThreadInitCallback may then run in several threads concurrently.
+			/// Call before start().
+			void setParallelStart(bool on) { parallelStart_ = on; }
 			void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
+			/// Default is kRoundRobin. Call it before start() or in the base loop.
+			void setLoopSelection(LoopSelection selection);
+			LoopSelection loopSelection() const { return selection_; }
+			/// Replaces the built-in policies. Call it before start() or in the base loop.
+			void setLoopSelector(const LoopSelector& selector) { selector_ = selector; }
+
 			// valid after calling start()
-			/// round-robin
+			/// by the selection policy, round-robin by default
 			EventLoop* getNextLoop();
 
 			/// with the same hash code, it will always return the same EventLoop
 			EventLoop* getLoopForHash(size_t hashCode);
 
+			/// The loop pinned to cpu, NULL if none is.
+			EventLoop* getLoopForCpu(int cpu);
+
 			std::vector<EventLoop*> getAllLoops();
 
 			bool started() const
@@ -50,14 +86,26 @@ namespace muduo
 			}
 
 		private:
+			EventLoop* getRoundRobin();
+			EventLoop* getLeastConnections();
+			EventLoop* getLeastBusy();
+			EventLoop* getPowerOfTwoChoices();
+			uint32_t random();
 
 			EventLoop* baseLoop_;	// 与Acceptor所属的EventLoop相同
 			string name_;
 			bool started_;		// 是否启动
 			int numThreads_;		// 线程数
 			int next_;			// 新线程到来，所选择的EventLoop对象下标
+			std::vector<int> cpus_;
+			bool numaLocal_;
+			bool parallelStart_;
+			LoopSelection selection_;
+			LoopSelector selector_;	// 为空时轮叫
+			uint32_t seed_;		// kPowerOfTwoChoices的随机数状态
 			std::vector<std::unique_ptr<EventLoopThread>> threads_;	// IO线程列表
 			std::vector<EventLoop*> loops_;							// EventLoop列表
+			std::vector<EventLoop*> loopOfCpu_;	// 以CPU编号为下标，没有绑定的为NULL
 			//threads_所管理的对象都是栈上的对象，当我们释放threads_对象时，它所管理的对象也会自动释放
 			//而且它所管理的对象都是unique_ptr是独占的
 			//EventLoop都是栈上的对象，所以我们不需要在析构的时候释放它
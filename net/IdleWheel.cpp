@@ -0,0 +1,190 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/IdleWheel.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <algorithm>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int IdleWheel::kSlots;
+const int64_t IdleWheel::kTickMicroSeconds;
+
+IdleWheel::IdleWheel(EventLoop* loop)
+	: loop_(loop),
+	slots_(kSlots, NULL),
+	size_(0),
+	lastTick_(0),
+	ticking_(false)
+{
+}
+
+// EventLoop析构时可能不在IO线程，不取消定时器，它随TimerQueue一起销毁
+IdleWheel::~IdleWheel()
+{
+	for (TcpConnection* conn : slots_)
+	{
+		while (conn)
+		{
+			TcpConnection* next = conn->idleNext_;
+			conn->idleSlot_ = -1;
+			conn->idlePrev_ = NULL;
+			conn->idleNext_ = NULL;
+			conn = next;
+		}
+	}
+}
+
+void IdleWheel::update(TcpConnection* conn, Timestamp now)
+{
+	loop_->assertInLoopThread();
+	if (conn->idleSlot_ >= 0)
+	{
+		remove(conn);
+	}
+	const int64_t deadline = conn->nextIdleDeadline();
+	if (deadline < 0)
+	{
+		return;
+	}
+	if (!ticking_)
+	{
+		// 没有连接时不转，省掉空闲loop的唤醒
+		ticking_ = true;
+		lastTick_ = now.microSecondsSinceEpoch() / kTickMicroSeconds;
+		const double interval = static_cast<double>(kTickMicroSeconds) / Timestamp::kMicroSecondsPerSecond;
+		timer_ = loop_->runEvery(interval, std::bind(&IdleWheel::tick, this), interval / 2);
+	}
+	link(conn, deadline);
+}
+
+void IdleWheel::remove(TcpConnection* conn)
+{
+	loop_->assertInLoopThread();
+	if (conn->idleSlot_ < 0)
+	{
+		return;
+	}
+	if (conn->idlePrev_)
+	{
+		conn->idlePrev_->idleNext_ = conn->idleNext_;
+	}
+	else
+	{
+		slots_[conn->idleSlot_] = conn->idleNext_;
+	}
+	if (conn->idleNext_)
+	{
+		conn->idleNext_->idlePrev_ = conn->idlePrev_;
+	}
+	conn->idleSlot_ = -1;
+	conn->idlePrev_ = NULL;
+	conn->idleNext_ = NULL;
+	--size_;
+}
+
+void IdleWheel::link(TcpConnection* conn, int64_t deadline)
+{
+	assert(conn->idleSlot_ < 0);
+	// 向上取整，不会提前触发
+	int64_t tick = (deadline + kTickMicroSeconds - 1) / kTickMicroSeconds;
+	if (tick <= lastTick_)
+	{
+		tick = lastTick_ + 1;
+	}
+	const int slot = static_cast<int>(tick % kSlots);
+	conn->idleSlot_ = slot;
+	conn->idlePrev_ = NULL;
+	conn->idleNext_ = slots_[slot];
+	if (slots_[slot])
+	{
+		slots_[slot]->idlePrev_ = conn;
+	}
+	slots_[slot] = conn;
+	++size_;
+}
+
+void IdleWheel::tick()
+{
+	loop_->assertInLoopThread();
+	const Timestamp now(Timestamp::now());
+	const int64_t nowTick = now.microSecondsSinceEpoch() / kTickMicroSeconds;
+	// 落后超过一圈时每个slot只处理一次
+	const int64_t last = std::min(nowTick, lastTick_ + kSlots);
+	while (lastTick_ < last)
+	{
+		++lastTick_;
+		const int slot = static_cast<int>(lastTick_ % kSlots);
+		TcpConnection* conn = slots_[slot];
+		slots_[slot] = NULL;
+		while (conn)
+		{
+			TcpConnection* next = conn->idleNext_;
+			conn->idleSlot_ = -1;
+			conn->idlePrev_ = NULL;
+			conn->idleNext_ = NULL;
+			--size_;
+			// 回调中可能关闭其他连接，先持有它们
+			scratch_.push_back(conn->shared_from_this());
+			conn = next;
+		}
+		for (const TcpConnectionPtr& c : scratch_)
+		{
+			expire(c, now);
+		}
+		scratch_.clear();
+	}
+	lastTick_ = nowTick;
+
+	if (size_ == 0)
+	{
+		loop_->cancel(timer_);
+		ticking_ = false;
+	}
+}
+
+void IdleWheel::expire(const TcpConnectionPtr& conn, Timestamp now)
+{
+	// 正在关闭的和移走的连接不再检查
+	if (!conn->connected() || conn->getLoop() != loop_)
+	{
+		return;
+	}
+	const int64_t nowUs = now.microSecondsSinceEpoch();
+	const IdleEvent events[] = { kReadIdle, kWriteIdle, kAllIdle };
+	for (IdleEvent event : events)
+	{
+		if (conn->idleTimeouts_[event] > 0 && conn->idleDeadline(event) <= nowUs)
+		{
+			// 从现在开始重新计时，一直空闲的话每个周期触发一次
+			conn->idleSince_[event] = nowUs;
+			if (conn->idleCallback_)
+			{
+				conn->idleCallback_(conn, event);
+			}
+			else
+			{
+				LOG_DEBUG << "IdleWheel::expire [" << conn->name() << "] - idle, closing";
+				conn->forceClose();
+			}
+			if (!conn->connected())
+			{
+				return;
+			}
+		}
+	}
+	// 回调中可能已经调用setIdleTimeout()重新放进来了
+	if (conn->idleSlot_ < 0 && conn->getLoop() == loop_)
+	{
+		const int64_t deadline = conn->nextIdleDeadline();
+		if (deadline >= 0)
+		{
+			link(conn.get(), deadline);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_IDLEWHEEL_H
+#define MUDUO_NET_IDLEWHEEL_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/Callbacks.h"
+#include "muduo/net/TimerId.h"
+
+#include <vector>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		class EventLoop;
+
+		///
+		/// Idle timeouts of the connections of one loop, see
+		/// TcpConnection::setIdleTimeout().
+		///
+		/// A timing wheel of 512 slots of 0.1 second. A connection is linked
+		/// into the slot of its earliest deadline, through itself. Traffic only
+		/// stores a timestamp in the connection, the deadline is computed again
+		/// when the wheel reaches the slot: a connection which has been active
+		/// moves to a later slot, an idle one fires. Deadlines farther than one
+		/// turn are checked once per turn. The wheel only ticks while it holds
+		/// connections.
+		///
+		/// Must be used in the loop thread.
+		class IdleWheel : noncopyable
+		{
+		public:
+			static const int kSlots = 512;
+			static const int64_t kTickMicroSeconds = 100 * 1000;
+
+			explicit IdleWheel(EventLoop* loop);
+			~IdleWheel();
+
+			/// Links conn by its idle timeouts, or unlinks it if they are all off.
+			void update(TcpConnection* conn, Timestamp now);
+			void remove(TcpConnection* conn);
+
+			size_t size() const { return size_; }
+
+		private:
+			void tick();
+			void expire(const TcpConnectionPtr& conn, Timestamp now);
+			void link(TcpConnection* conn, int64_t deadline);
+
+			EventLoop* loop_;
+			std::vector<TcpConnection*> slots_;
+			size_t size_;
+			int64_t lastTick_;		// 最近处理过的tick
+			bool ticking_;
+			TimerId timer_;
+			std::vector<TcpConnectionPtr> scratch_;	// 正在处理的一个slot
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_IDLEWHEEL_H
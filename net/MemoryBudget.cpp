@@ -0,0 +1,221 @@
+#include "muduo/net/MemoryBudget.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <algorithm>
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t MemoryBudget::kMinHeavyBytes;
+
+namespace
+{
+	const char* levelName(MemoryBudget::Level level)
+	{
+		switch (level)
+		{
+		case MemoryBudget::kNormal:
+			return "normal";
+		case MemoryBudget::kPauseReading:
+			return "pause reading";
+		case MemoryBudget::kRejectNew:
+			return "reject new connections";
+		case MemoryBudget::kShed:
+			return "shed connections";
+		default:
+			return "unknown";
+		}
+	}
+}
+
+MemoryBudget::MemoryBudget(size_t limit)
+	: limit_(limit),
+	pauseBytes_(0),
+	rejectBytes_(0),
+	used_(0),
+	peak_(0),
+	numPaused_(0),
+	numRejected_(0),
+	numShed_(0)
+{
+	setRatios(0.6, 0.8);
+}
+
+void MemoryBudget::setRatios(double pauseRatio, double rejectRatio)
+{
+	assert(0 < pauseRatio && pauseRatio <= rejectRatio && rejectRatio <= 1.0);
+	pauseBytes_ = static_cast<int64_t>(static_cast<double>(limit_) * pauseRatio);
+	rejectBytes_ = static_cast<int64_t>(static_cast<double>(limit_) * rejectRatio);
+}
+
+MemoryBudget::Level MemoryBudget::level() const
+{
+	const int64_t bytes = used();
+	if (bytes >= static_cast<int64_t>(limit_))
+	{
+		return kShed;
+	}
+	else if (bytes >= rejectBytes_)
+	{
+		return kRejectNew;
+	}
+	else if (bytes >= pauseBytes_)
+	{
+		return kPauseReading;
+	}
+	return kNormal;
+}
+
+bool MemoryBudget::admit()
+{
+	if (used() >= rejectBytes_)
+	{
+		numRejected_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+string MemoryBudget::report() const
+{
+	size_t connections = 0;
+	size_t paused = 0;
+	{
+		MutexLockGuard lock(mutex_);
+		connections = connections_.size();
+		paused = paused_.size();
+	}
+	char buf[512];
+	snprintf(buf, sizeof buf,
+		"used %" PRId64 " bytes of %zu, peak %" PRId64 "\n"
+		"level %s, pause reading at %" PRId64 ", reject new at %" PRId64 "\n"
+		"connections %zu, paused now %zu\n"
+		"paused %" PRId64 ", rejected %" PRId64 ", shed %" PRId64 "\n",
+		used(), limit_, peak(),
+		levelName(level()), pauseBytes_, rejectBytes_,
+		connections, paused,
+		numPaused(), numRejected(), numShed());
+	return buf;
+}
+
+void MemoryBudget::addConnection(const TcpConnectionPtr& conn)
+{
+	MutexLockGuard lock(mutex_);
+	connections_[conn.get()] = conn;
+}
+
+void MemoryBudget::removeConnection(TcpConnection* conn, int64_t charged)
+{
+	{
+		MutexLockGuard lock(mutex_);
+		connections_.erase(conn);
+	}
+	if (charged != 0)
+	{
+		charge(-charged);
+	}
+}
+
+void MemoryBudget::charge(int64_t delta)
+{
+	const int64_t oldUsed = used_.fetch_add(delta, std::memory_order_relaxed);
+	const int64_t newUsed = oldUsed + delta;
+	if (delta > 0)
+	{
+		int64_t peak = peak_.load(std::memory_order_relaxed);
+		while (newUsed > peak
+			&& !peak_.compare_exchange_weak(peak, newUsed, std::memory_order_relaxed))
+		{
+		}
+		// 只在越过上限的那一次挑选要关闭的连接
+		if (oldUsed < static_cast<int64_t>(limit_) && newUsed >= static_cast<int64_t>(limit_))
+		{
+			shed();
+		}
+	}
+	else if (oldUsed >= pauseBytes_ && newUsed < pauseBytes_)
+	{
+		resumeAll();
+	}
+}
+
+bool MemoryBudget::pauseReading(const TcpConnectionPtr& conn, int64_t bytes)
+{
+	if (bytes < static_cast<int64_t>(kMinHeavyBytes))
+	{
+		return false;
+	}
+	// 在锁内判断，resumeAll()之后不会再有连接被暂停而无人恢复
+	MutexLockGuard lock(mutex_);
+	const int64_t total = used();
+	// 只暂停占用超过平均值的连接
+	if (total < pauseBytes_
+		|| bytes * static_cast<int64_t>(connections_.size()) < total)
+	{
+		return false;
+	}
+	paused_.push_back(conn);
+	numPaused_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void MemoryBudget::resumeAll()
+{
+	std::vector<std::weak_ptr<TcpConnection> > paused;
+	{
+		MutexLockGuard lock(mutex_);
+		paused.swap(paused_);
+	}
+	for (const auto& weak : paused)
+	{
+		TcpConnectionPtr conn(weak.lock());
+		if (conn)
+		{
+			conn->queueInLoop(std::bind(&TcpConnection::resumeReadingInLoop, conn));
+		}
+	}
+}
+
+void MemoryBudget::shed()
+{
+	typedef std::pair<int64_t, TcpConnectionPtr> Candidate;
+	std::vector<Candidate> candidates;
+	{
+		MutexLockGuard lock(mutex_);
+		for (const auto& entry : connections_)
+		{
+			TcpConnectionPtr conn(entry.second.lock());
+			if (conn)
+			{
+				candidates.push_back(Candidate(conn->memoryCharged_.load(std::memory_order_relaxed), conn));
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Candidate& lhs, const Candidate& rhs) { return lhs.first > rhs.first; });
+
+	// 从最大的开始关闭，直到回到拒绝新连接的水位以下
+	int64_t excess = used() - rejectBytes_;
+	for (const Candidate& candidate : candidates)
+	{
+		if (excess <= 0 || candidate.first == 0)
+		{
+			break;
+		}
+		LOG_WARN << "MemoryBudget::shed " << candidate.second->name()
+			<< " holding " << candidate.first << " bytes";
+		candidate.second->forceClose();
+		excess -= candidate.first;
+		numShed_.fetch_add(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,94 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_MEMORYBUDGET_H
+#define MUDUO_NET_MEMORYBUDGET_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Callbacks.h"
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		/// Bytes held in the input and output buffers of all connections,
+		/// shared by the TcpServers of every EventLoop.
+		///
+		/// The framework keeps the total under the limit in three steps:
+		/// - above pauseRatio of the limit, connections holding more than the
+		///   average stop reading, until the total drops below it again.
+		/// - above rejectRatio, TcpServer closes new connections at once.
+		/// - at the limit, the largest connections are closed until the total
+		///   would be back under rejectRatio.
+		///
+		/// Thread safe.
+		// 全局内存预算，所有连接的缓冲区共用
+		class MemoryBudget : noncopyable
+		{
+		public:
+			enum Level { kNormal, kPauseReading, kRejectNew, kShed };
+
+			static const size_t kMinHeavyBytes = 64 * 1024;	// 小于这个的连接不暂停读
+
+			explicit MemoryBudget(size_t limit);
+
+			/// Must be called before any connection uses the budget.
+			void setRatios(double pauseRatio, double rejectRatio);
+
+			size_t limit() const { return limit_; }
+			int64_t used() const { return used_.load(std::memory_order_relaxed); }
+			int64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+			Level level() const;
+
+			/// Called by TcpServer for each new connection,
+			/// false means the connection should be refused.
+			bool admit();
+
+			int64_t numPaused() const { return numPaused_.load(std::memory_order_relaxed); }
+			int64_t numRejected() const { return numRejected_.load(std::memory_order_relaxed); }
+			int64_t numShed() const { return numShed_.load(std::memory_order_relaxed); }
+
+			/// Usage, thresholds and counters in plain text, for Inspector.
+			string report() const;
+
+			// internal usage, called by TcpConnection in its loop thread
+			void addConnection(const TcpConnectionPtr& conn);
+			void removeConnection(TcpConnection* conn, int64_t charged);
+			void charge(int64_t delta);
+			/// Whether a connection holding bytes should stop reading,
+			/// if so it is remembered and resumed later.
+			bool pauseReading(const TcpConnectionPtr& conn, int64_t bytes);
+
+		private:
+			typedef std::map<TcpConnection*, std::weak_ptr<TcpConnection> > ConnectionMap;
+
+			void resumeAll();
+			void shed();
+
+			const size_t limit_;
+			int64_t pauseBytes_;
+			int64_t rejectBytes_;
+			std::atomic<int64_t> used_;
+			std::atomic<int64_t> peak_;
+			std::atomic<int64_t> numPaused_;	// 累计暂停读的次数
+			std::atomic<int64_t> numRejected_;
+			std::atomic<int64_t> numShed_;
+
+			mutable MutexLock mutex_;
+			ConnectionMap connections_ GUARDED_BY(mutex_);
+			std::vector<std::weak_ptr<TcpConnection> > paused_ GUARDED_BY(mutex_);
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_MEMORYBUDGET_H
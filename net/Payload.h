@@ -0,0 +1,105 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PAYLOAD_H
+#define MUDUO_NET_PAYLOAD_H
+
+#include "muduo/base/copyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include <memory>
+
+#include <assert.h>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		/// Immutable bytes shared by many connections without copying,
+		/// e.g. one frame broadcast to all subscribers.
+		///
+		/// Copying a Payload only bumps a reference count. The bytes are freed
+		/// with the last copy, including the ones queued in output buffers.
+		/// Safe to pass between threads, nobody can modify the bytes.
+		// 引用计数的只读数据，TcpConnection::send(const Payload&)只保存引用
+		class Payload : public muduo::copyable
+		{
+		public:
+			Payload()
+				: offset_(0),
+				size_(0)
+			{
+			}
+
+			explicit Payload(string&& data)
+				: offset_(0),
+				size_(data.size())
+			{
+				share(std::make_shared<const string>(std::move(data)));
+			}
+
+			// copies data once
+			explicit Payload(const StringPiece& data)
+				: offset_(0),
+				size_(data.size())
+			{
+				share(std::make_shared<const string>(data.data(), data.size()));
+			}
+
+			/// Takes a block of len bytes allocated with new char[], no copy.
+			Payload(std::unique_ptr<char[]> data, size_t len)
+				: storage_(data.release(), std::default_delete<char[]>()),
+				offset_(0),
+				size_(len)
+			{
+			}
+
+			const char* data() const { return storage_ ? storage_.get() + offset_ : NULL; }
+			size_t size() const { return size_; }
+			bool empty() const { return size_ == 0; }
+
+			StringPiece toStringPiece() const
+			{
+				return StringPiece(data(), static_cast<int>(size_));
+			}
+
+			/// A part of this payload, sharing the same bytes.
+			Payload slice(size_t offset, size_t len) const
+			{
+				assert(offset + len <= size_);
+				Payload result(*this);
+				result.offset_ += offset;
+				result.size_ = len;
+				return result;
+			}
+
+			void removePrefix(size_t n)
+			{
+				assert(n <= size_);
+				offset_ += n;
+				size_ -= n;
+			}
+
+			/// Number of Payload objects sharing the bytes, for tests and stats.
+			long useCount() const { return storage_.use_count(); }
+
+		private:
+			// 与str共享引用计数，指向其中的字节
+			void share(const std::shared_ptr<const string>& str)
+			{
+				storage_ = std::shared_ptr<const char>(str, str->data());
+			}
+
+			std::shared_ptr<const char> storage_;
+			size_t offset_;
+			size_t size_;
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PAYLOAD_H
@@ -126,3 +126,23 @@ void Socket::setKeepAlive(bool on)
 	// FIXME CHECK
 }
 
+bool Socket::setZeroCopy(bool on)
+{
+#ifdef SO_ZEROCOPY
+	int optval = on ? 1 : 0;
+	int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY,
+		&optval, static_cast<socklen_t>(sizeof optval));
+	if (ret < 0 && on)
+	{
+		LOG_SYSERR << "SO_ZEROCOPY failed.";
+	}
+	return ret == 0;
+#else
+	if (on)
+	{
+		LOG_ERROR << "SO_ZEROCOPY is not supported.";
+	}
+	return !on;
+#endif
+}
+
@@ -83,6 +83,11 @@ namespace muduo
 			// TCP keepalive是指定期探测连接是否存在，如果应用层有心跳包，这个选项是不需要设置的
 			void setKeepAlive(bool on);
 
+			///
+			// Enable/disable SO_ZEROCOPY, needed by MSG_ZEROCOPY sends (Linux 4.14)
+			// @return false if the kernel doesn't support it
+			bool setZeroCopy(bool on);
+
 		private:
 			//socket类只有一个数据成员，即套接字
 			const int sockfd_;
@@ -14,9 +14,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
 #include <stdio.h>  // snprintf
+#include <sys/sendfile.h>
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 using namespace muduo;
@@ -142,7 +144,11 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr)
 	if (connfd < 0)
 	{
 		int savedErrno = errno;
-		LOG_SYSERR << "Socket::accept";
+		// 没有连接可以accept不算错误，监听socket被多个线程共用时常见
+		if (savedErrno != EAGAIN)
+		{
+			LOG_SYSERR << "Socket::accept";
+		}
 		//当连接失败时，查看返回的错误是什么错误，如果不是致命的错误就返回回来
 		switch (savedErrno)
 		{
@@ -195,6 +201,57 @@ ssize_t sockets::write(int sockfd, const void* buf, size_t count)
 	return ::write(sockfd, buf, count);
 }
 
+//writev把多个缓冲区的数据一次写出，与readv相对应
+ssize_t sockets::writev(int sockfd, const struct iovec* iov, int iovcnt)
+{
+	return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int infd, off_t* offset, size_t count)
+{
+	return ::sendfile(sockfd, infd, offset, count);
+}
+
+ssize_t sockets::sendZeroCopy(int sockfd, const void* buf, size_t count)
+{
+#ifdef MSG_ZEROCOPY
+	return ::send(sockfd, buf, count, MSG_ZEROCOPY);
+#else
+	return ::send(sockfd, buf, count, 0);
+#endif
+}
+
+int sockets::readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied)
+{
+	char control[128];
+	struct msghdr msg;
+	memZero(&msg, sizeof msg);
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof control;
+	if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+	{
+		return -1;
+	}
+	for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+	{
+		if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+			|| (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+		{
+			struct sock_extended_err serr;
+			memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+			if (serr.ee_errno == 0 && serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+			{
+				*lo = serr.ee_info;
+				*hi = serr.ee_data;
+				// 内核没有零拷贝而是复制了数据，例如loopback
+				*copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
 void sockets::close(int sockfd)
 {
 	if (::close(sockfd) < 0)
@@ -289,6 +346,22 @@ int sockets::getSocketError(int sockfd)
 	}
 }
 
+int sockets::getIncomingCpu(int sockfd)
+{
+#ifdef SO_INCOMING_CPU
+	int cpu = -1;
+	socklen_t optlen = static_cast<socklen_t>(sizeof cpu);
+	if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0)
+	{
+		return -1;
+	}
+	return cpu;
+#else
+	(void)sockfd;
+	return -1;
+#endif
+}
+
 //过去套接字的地址
 //对于一个已连接的套接字，它有一个本地IP地址和对等方IP地址
 
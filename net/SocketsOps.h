@@ -29,6 +29,15 @@ namespace muduo
 			ssize_t read(int sockfd, void* buf, size_t count);
 			ssize_t readv(int sockfd, const struct iovec* iov, int iovcnt);
 			ssize_t write(int sockfd, const void* buf, size_t count);
+			ssize_t writev(int sockfd, const struct iovec* iov, int iovcnt);
+			// 在内核中把文件数据直接发送到套接字，offset会被更新
+			ssize_t sendfile(int sockfd, int infd, off_t* offset, size_t count);
+			// send(2) with MSG_ZEROCOPY, buf must not change until the completion
+			// shows up in the error queue, the n-th successful call has id n-1
+			ssize_t sendZeroCopy(int sockfd, const void* buf, size_t count);
+			// 从错误队列中读取一个MSG_ZEROCOPY完成通知，id在[*lo, *hi]之间的发送已完成
+			// @return 1 for a completion, 0 for other messages, -1 on error or empty queue
+			int readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied);
 			void close(int sockfd);
 			void shutdownWrite(int sockfd);
 
@@ -43,6 +52,9 @@ namespace muduo
 				struct sockaddr_in6* addr);
 
 			int getSocketError(int sockfd);
+			/// CPU which handled the last packet of the socket, SO_INCOMING_CPU,
+			/// -1 if unknown.
+			int getIncomingCpu(int sockfd);
 
 			const struct sockaddr* sockaddr_cast(const struct sockaddr_in* addr);
 			const struct sockaddr* sockaddr_cast(const struct sockaddr_in6* addr);
@@ -61,6 +61,10 @@ TcpClient::TcpClient(EventLoop* loop,
 	messageCallback_(defaultMessageCallback),
 	retry_(false),
 	connect_(true),
+	readIdle_(0),
+	writeIdle_(0),
+	allIdle_(0),
+	memoryBudget_(NULL),
 	nextConnId_(1)
 {
 	// ӳɹصһӽɹͻصnewConnection
@@ -158,6 +162,12 @@ void TcpClient::newConnection(int sockfd)
 	conn->setConnectionCallback(connectionCallback_);
 	conn->setMessageCallback(messageCallback_);
 	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	if (readIdle_ > 0 || writeIdle_ > 0 || allIdle_ > 0)
+	{
+		conn->setIdleCallback(idleCallback_);
+		conn->setIdleTimeout(readIdle_, writeIdle_, allIdle_);
+	}
+	conn->setMemoryBudget(memoryBudget_);
 	conn->setCloseCallback(
 		std::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
 	{
@@ -72,6 +72,25 @@ namespace muduo
 				writeCompleteCallback_ = std::move(cb);
 			}
 
+			/// Idle timeouts of the connection in seconds, 0 turns one off,
+			/// see TcpConnection::setIdleTimeout(). Without cb an idle connection
+			/// is closed, and reconnects if retry is enabled.
+			/// Not thread safe, applies to the next connection.
+			void setIdleTimeout(double readIdle, double writeIdle, double allIdle,
+				IdleCallback cb = IdleCallback())
+			{
+				readIdle_ = readIdle;
+				writeIdle_ = writeIdle;
+				allIdle_ = allIdle;
+				idleCallback_ = std::move(cb);
+			}
+
+			/// Charges the buffers of the connection to budget, which may be
+			/// shared with servers, see TcpServer::setMemoryBudget().
+			/// budget must outlive the client.
+			/// Not thread safe, applies to the next connection.
+			void setMemoryBudget(MemoryBudget* budget) { memoryBudget_ = budget; }
+
 		private:
 			/// Not thread safe, but in loop
 			void newConnection(int sockfd);
@@ -86,6 +105,11 @@ namespace muduo
 			WriteCompleteCallback writeCompleteCallback_;	// ݷϻص
 			bool retry_;   // atomic	// ,ָӽֶ֮ϿʱǷ
 			bool connect_; // atomic
+			double readIdle_;
+			double writeIdle_;
+			double allIdle_;
+			IdleCallback idleCallback_;
+			MemoryBudget* memoryBudget_;	// ΪNULL
 			// always in loop thread
 			int nextConnId_;		// name + nextConnId_ڱʶһ
 			mutable MutexLock mutex_;
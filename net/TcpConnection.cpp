@@ -10,17 +10,38 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/base/WeakCallback.h"
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/net/IdleWheel.h"
+#include "muduo/net/MemoryBudget.h"
 #include "muduo/net/Socket.h"
 #include "muduo/net/SocketsOps.h"
 #include "TcpConnection.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <errno.h>
+#include <sched.h>
+#include <sys/uio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+const size_t TcpConnection::kMinReadSize;
+const size_t TcpConnection::kMaxReadSize;
+const size_t TcpConnection::kDefaultReadBudget;
+
+namespace
+{
+	// 只有IO线程写，不需要带lock前缀的原子加法
+	void addCounter(std::atomic<int64_t>* counter, int64_t n)
+	{
+		counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+}
+
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
 	LOG_TRACE << conn->localAddress().toIpPort() << " -> "
@@ -42,15 +63,50 @@ TcpConnection::TcpConnection(EventLoop* loop,
 	const InetAddress& localAddr,
 	const InetAddress& peerAddr)
 	: loop_(CHECK_NOTNULL(loop)),
+	moving_(0),
+	posting_(0),
+	pendingQueued_(false),
+	pendingFenced_(false),
+	movesDone_(0),
 	name_(nameArg),
 	state_(kConnecting),
 	reading_(true),//是否
+	autoCork_(false),
+	corked_(false),
 	socket_(new Socket(sockfd)),//创建一个套接字
 	channel_(new Channel(loop, sockfd)),//构造一个通道
 	localAddr_(localAddr),//本地地址
 	peerAddr_(peerAddr),//对等方地址
-	highWaterMark_(64 * 1024 * 1024)
+	highWaterMark_(64 * 1024 * 1024),
+	backpressureHigh_(0),
+	backpressureLow_(0),
+	backpressured_(false),
+	throttles_(0),
+	memoryBudget_(NULL),
+	memoryCharged_(0),
+	memoryPaused_(false),
+	inputBuffer_(BufferPool::emptyBuffer()),	// 缓冲区在第一次读写时才从内存池分配
+	outputBuffer_(loop->bufferPool()),
+	readSize_(kMinReadSize),
+	shortReads_(0),
+	readBudget_(kDefaultReadBudget),
+	readIteration_(-1),
+	creationTime_(Timestamp::now()),
+	lastReceiveTime_(0),
+	lastSendTime_(0),
+	bytesReceived_(0),
+	bytesSent_(0),
+	readCalls_(0),
+	writeCalls_(0),
+	peakOutputBytes_(0),
+	highWaterMicroSeconds_(0),
+	aboveHighWaterSince_(0),
+	idleSlot_(-1),
+	idlePrev_(NULL),
+	idleNext_(NULL)
 {
+	memZero(idleTimeouts_, sizeof idleTimeouts_);
+	memZero(idleSince_, sizeof idleSince_);
 	//通道可读事件到来时，回调TcpConnection::handleRead，_1是事件发生时间
 	channel_->setReadCallback(
 		std::bind(&TcpConnection::handleRead, this, _1));
@@ -70,6 +126,7 @@ TcpConnection::TcpConnection(EventLoop* loop,
 		<< " fd=" << sockfd;
 
 	socket_->setKeepAlive(true);
+	getLoop()->adjustConnections(1);
 }
 
 TcpConnection::~TcpConnection()
@@ -78,6 +135,7 @@ TcpConnection::~TcpConnection()
 		<< " fd=" << channel_->fd()
 		<< " state=" << stateToString();
 	assert(state_ == kDisconnected);
+	assert(idleSlot_ < 0);
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
@@ -93,6 +151,27 @@ string TcpConnection::getTcpInfoString() const
 	return buf;
 }
 
+TcpConnectionStats TcpConnection::stats() const
+{
+	TcpConnectionStats s;
+	s.creationTime = creationTime_;
+	s.lastReceiveTime = Timestamp(lastReceiveTime_.load(std::memory_order_relaxed));
+	s.lastSendTime = Timestamp(lastSendTime_.load(std::memory_order_relaxed));
+	s.bytesReceived = bytesReceived_.load(std::memory_order_relaxed);
+	s.bytesSent = bytesSent_.load(std::memory_order_relaxed);
+	s.readCalls = readCalls_.load(std::memory_order_relaxed);
+	s.writeCalls = writeCalls_.load(std::memory_order_relaxed);
+	s.peakOutputBytes = peakOutputBytes_.load(std::memory_order_relaxed);
+	int64_t above = highWaterMicroSeconds_.load(std::memory_order_relaxed);
+	const int64_t since = aboveHighWaterSince_.load(std::memory_order_relaxed);
+	if (since > 0)
+	{
+		above += std::max<int64_t>(Timestamp::now().microSecondsSinceEpoch() - since, 0);
+	}
+	s.secondsAboveHighWaterMark = static_cast<double>(above) / Timestamp::kMicroSecondsPerSecond;
+	return s;
+}
+
 void TcpConnection::send(const void* data, int len)
 {
 	send(StringPiece(static_cast<const char*>(data), len));
@@ -104,7 +183,7 @@ void TcpConnection::send(const StringPiece& message)
 	if (state_ == kConnected)
 	{
 		//判断是否在IO线程当中
-		if (loop_->isInLoopThread())
+		if (getLoop()->isInLoopThread())
 		{
 			//在IO线程当中调用sendInLoop(message);
 			sendInLoop(message);
@@ -114,7 +193,7 @@ void TcpConnection::send(const StringPiece& message)
 			//不在IO线程当中调用runInLoop(message);，把事件放入IO线程的队列中
 			//然后再IO线程中再调用SendInLoop(message);
 			void (TcpConnection:: * fp)(const StringPiece & message) = &TcpConnection::sendInLoop;
-			loop_->runInLoop(
+			runInLoop(
 				std::bind(fp,
 					this,     // FIXME
 					message.as_string()));
@@ -123,20 +202,81 @@ void TcpConnection::send(const StringPiece& message)
 	}
 }
 
-// FIXME efficiency!!!
+void TcpConnection::send(const char* message)
+{
+	send(StringPiece(message));
+}
+
+void TcpConnection::send(string&& message)
+{
+	if (state_ == kConnected)
+	{
+		if (getLoop()->isInLoopThread())
+		{
+			sendInLoop(message);
+		}
+		else
+		{
+			// 字符串的内存转给Payload，不复制
+			void (TcpConnection:: * fp)(const Payload & payload) = &TcpConnection::sendInLoop;
+			runInLoop(
+				std::bind(fp,
+					this,     // FIXME
+					Payload(std::move(message))));
+		}
+	}
+}
+
+void TcpConnection::sendv(const StringPiece* pieces, size_t count)
+{
+	if (state_ == kConnected)
+	{
+		if (getLoop()->isInLoopThread())
+		{
+			struct iovec stackvec[BufferChain::kMaxIovecs];
+			std::vector<struct iovec> heapvec;
+			struct iovec* vec = stackvec;
+			if (count > static_cast<size_t>(BufferChain::kMaxIovecs))
+			{
+				heapvec.resize(count);
+				vec = heapvec.data();
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				vec[i].iov_base = const_cast<char*>(pieces[i].data());
+				vec[i].iov_len = pieces[i].size();
+			}
+			sendInLoop(vec, static_cast<int>(count));
+		}
+		else
+		{
+			// the pieces may not outlive this call, so they are concatenated here
+			string message;
+			for (size_t i = 0; i < count; ++i)
+			{
+				message.append(pieces[i].data(), pieces[i].size());
+			}
+			void (TcpConnection:: * fp)(const StringPiece & message) = &TcpConnection::sendInLoop;
+			runInLoop(
+				std::bind(fp,
+					this,     // FIXME
+					std::move(message)));
+		}
+	}
+}
+
 void TcpConnection::send(Buffer* buf)
 {
 	if (state_ == kConnected)
 	{
-		if (loop_->isInLoopThread())
+		if (getLoop()->isInLoopThread())
 		{
-			sendInLoop(buf->peek(), buf->readableBytes());
-			buf->retrieveAll();
+			sendInLoop(buf);
 		}
 		else
 		{
 			void (TcpConnection:: * fp)(const StringPiece & message) = &TcpConnection::sendInLoop;
-			loop_->runInLoop(
+			runInLoop(
 				std::bind(fp,
 					this,     // FIXME
 					buf->retrieveAllAsString()));
@@ -145,6 +285,80 @@ void TcpConnection::send(Buffer* buf)
 	}
 }
 
+void TcpConnection::send(Buffer&& buf)
+{
+	if (state_ == kConnected)
+	{
+		if (getLoop()->isInLoopThread())
+		{
+			sendInLoop(&buf);
+		}
+		else
+		{
+			// buf被move进functor，在IO线程中与output buffer交换数据
+			runInLoop(
+				std::bind(&TcpConnection::sendBufferInLoop,
+					this,     // FIXME
+					std::move(buf)));
+		}
+	}
+}
+
+void TcpConnection::send(const Payload& payload)
+{
+	if (state_ == kConnected)
+	{
+		if (getLoop()->isInLoopThread())
+		{
+			sendInLoop(payload);
+		}
+		else
+		{
+			// 只复制引用，不复制数据
+			void (TcpConnection:: * fp)(const Payload & payload) = &TcpConnection::sendInLoop;
+			runInLoop(
+				std::bind(fp,
+					this,     // FIXME
+					payload));
+		}
+	}
+}
+
+void TcpConnection::send(std::unique_ptr<char[]> data, size_t len)
+{
+	send(Payload(std::move(data), len));
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+	// 否则sendfile()返回0，会被当成文件不够长
+	if (length == 0)
+	{
+		return;
+	}
+	if (state_ == kConnected)
+	{
+		// dup() here, the caller's fd may be closed before the loop runs
+		FileRegionPtr file(new FileRegion(fd, offset, length));
+		if (!file->valid())
+		{
+			LOG_SYSERR << "TcpConnection::sendFile";
+			return;
+		}
+		if (getLoop()->isInLoopThread())
+		{
+			sendFileInLoop(file);
+		}
+		else
+		{
+			runInLoop(
+				std::bind(&TcpConnection::sendFileInLoop,
+					this,     // FIXME
+					file));
+		}
+	}
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
 	sendInLoop(message.data(), message.size());
@@ -152,68 +366,274 @@ void TcpConnection::sendInLoop(const StringPiece& message)
 
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-	loop_->assertInLoopThread();
-	ssize_t nwrote = 0;
-	size_t remaining = len;
-	bool faultError = false;
+	struct iovec vec;
+	vec.iov_base = const_cast<void*>(data);
+	vec.iov_len = len;
+	sendInLoop(&vec, 1);
+}
+
+void TcpConnection::sendInLoop(const struct iovec* iov, int iovcnt)
+{
+	getLoop()->assertInLoopThread();
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; ++i)
+	{
+		len += iov[i].iov_len;
+	}
+	size_t nwrote = 0;
+	if (!writeDirectly(iov, iovcnt, len, &nwrote))
+	{
+		return;
+	}
+
+	assert(nwrote <= len);
+	// 还有数据没有写完，说明内核当中的发送缓冲区满了，要将未写完的数据添加到output buffer中
+	if (nwrote < len)
+	{
+		checkHighWaterMark(len - nwrote);
+
+		// 跳过已经写入内核的nwrote字节，把剩下的数据依次添加到output buffer中
+		size_t skip = nwrote;
+		for (int i = 0; i < iovcnt; ++i)
+		{
+			if (skip >= iov[i].iov_len)
+			{
+				skip -= iov[i].iov_len;
+				continue;
+			}
+			outputBuffer_.append(static_cast<const char*>(iov[i].iov_base) + skip,
+				iov[i].iov_len - skip);
+			skip = 0;
+		}
+
+		// output buffer中有数据了，我们就要关注POLLOUT事件，如果没有关注我们就要立即关注
+		startWriting();
+	}
+}
+
+// this one will swap data, the unsent part of buf is queued without copying
+void TcpConnection::sendInLoop(Buffer* buf)
+{
+	getLoop()->assertInLoopThread();
+	struct iovec vec;
+	vec.iov_base = const_cast<char*>(buf->peek());
+	vec.iov_len = buf->readableBytes();
+	size_t nwrote = 0;
+	if (!writeDirectly(&vec, 1, vec.iov_len, &nwrote))
+	{
+		buf->retrieveAll();
+		return;
+	}
+
+	buf->retrieve(nwrote);
+	if (buf->readableBytes() > 0)
+	{
+		checkHighWaterMark(buf->readableBytes());
+		outputBuffer_.append(buf);
+		startWriting();
+	}
+}
+
+void TcpConnection::sendBufferInLoop(Buffer& buf)
+{
+	sendInLoop(&buf);
+}
+
+// the unsent part is queued as a slice of payload, sharing its bytes
+void TcpConnection::sendInLoop(const Payload& payload)
+{
+	getLoop()->assertInLoopThread();
+	struct iovec vec;
+	vec.iov_base = const_cast<char*>(payload.data());
+	vec.iov_len = payload.size();
+	const size_t threshold = outputBuffer_.zeroCopyThreshold();
+	const bool zeroCopy = threshold > 0 && payload.size() >= threshold;
+	size_t nwrote = 0;
+	if (!writeDirectly(&vec, 1, vec.iov_len, &nwrote, zeroCopy ? &payload : NULL))
+	{
+		return;
+	}
+
+	if (nwrote < payload.size())
+	{
+		checkHighWaterMark(payload.size() - nwrote);
+		outputBuffer_.append(payload.slice(nwrote, payload.size() - nwrote));
+		startWriting();
+	}
+}
+
+void TcpConnection::sendFileInLoop(const FileRegionPtr& file)
+{
+	getLoop()->assertInLoopThread();
 	if (state_ == kDisconnected)
 	{
 		LOG_WARN << "disconnected, give up writing";
 		return;
 	}
+	// 前面没有排队的数据，直接sendfile
+	if (!channel_->isWriting() && outputBuffer_.empty())
+	{
+		off_t offset = file->offset();
+		ssize_t n = sockets::sendfile(channel_->fd(), file->fd(), &offset, file->length());
+		countWrite(n);
+		if (n > 0)
+		{
+			file->advance(n);
+			if (file->length() == 0 && writeCompleteCallback_)
+			{
+				getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+			}
+		}
+		else if (n == 0)
+		{
+			LOG_ERROR << "TcpConnection::sendFileInLoop file is shorter than "
+				<< file->length() << " bytes";
+			return;
+		}
+		else if (errno != EWOULDBLOCK)
+		{
+			LOG_SYSERR << "TcpConnection::sendFileInLoop";
+			return;
+		}
+	}
+
+	if (file->length() > 0)
+	{
+		checkHighWaterMark(file->length());
+		outputBuffer_.append(file);
+		startWriting();
+	}
+}
+
+bool TcpConnection::writeDirectly(const struct iovec* iov, int iovcnt, size_t len, size_t* nwrote,
+	const Payload* zeroCopy)
+{
+	*nwrote = 0;
+	if (state_ == kDisconnected)
+	{
+		LOG_WARN << "disconnected, give up writing";
+		return false;
+	}
+	if (autoCork_ && !channel_->isWriting())
+	{
+		// 先放入output buffer，本轮循环结束时和其他数据一起发送
+		if (!corked_)
+		{
+			corked_ = true;
+			TcpConnectionPtr self(shared_from_this());
+			getLoop()->runAtEndOfIteration([self] { self->flushCorked(); });
+		}
+		return true;
+	}
 	// if no thing in output queue, try writing directly
 	// 通道中没有关注可写事件并且发送缓冲区没有数据，可以直接write
-	if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+	if (!channel_->isWriting() && outputBuffer_.empty())
 	{
-		nwrote = sockets::write(channel_->fd(), data, len);
-		if (nwrote >= 0)
+		ssize_t n = 0;
+		if (zeroCopy)
 		{
-			remaining = len - nwrote;
-			// remaining == 0说明要发送的数据都拷贝到了内核缓冲区，说明写完了
+			n = outputBuffer_.sendZeroCopy(channel_->fd(), *zeroCopy);
+		}
+		else
+		{
+			n = iovcnt == 1
+				? sockets::write(channel_->fd(), iov[0].iov_base, iov[0].iov_len)
+				: sockets::writev(channel_->fd(), iov, std::min(iovcnt, BufferChain::kMaxIovecs));
+		}
+		countWrite(n);
+		if (n >= 0)
+		{
+			*nwrote = implicit_cast<size_t>(n);
+			// 要发送的数据都拷贝到了内核缓冲区，说明写完了
 			// 写完了，就回调writeCompleteCallback_
-			// 如果remaining > 0,会在后面把为发送的数据添加到output buffer当中
-			if (remaining == 0 && writeCompleteCallback_)
+			if (*nwrote == len && writeCompleteCallback_)
 			{
-				loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+				getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
 			}
 		}
-		else // nwrote < 0，出错
+		else // n < 0，出错
 		{
-			nwrote = 0;
 			if (errno != EWOULDBLOCK)
 			{
 				LOG_SYSERR << "TcpConnection::sendInLoop";
 				if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
 				{
-					faultError = true;
+					return false;
 				}
 			}
 		}
 	}
+	return true;
+}
 
-	assert(remaining <= len);
-	// 断言没有错误，并且还有数据没有写完。说明内核当中的发送缓冲区满了，要将未写完的数据添加到output buffer中
-	if (!faultError && remaining > 0)
+void TcpConnection::startWriting()
+{
+	chargeMemory();
+	// flushCorked()会先写一次，写不完才关注POLLOUT事件
+	if (!corked_ && !channel_->isWriting())
 	{
-		size_t oldLen = outputBuffer_.readableBytes();	// 当前output buffer中的数据
-
-		//  如果操作highWaterMark_(高水位标),回调highWaterMarkCallback_
-		if (oldLen + remaining >= highWaterMark_
-			&& oldLen < highWaterMark_
-			&& highWaterMarkCallback_)
+		// 边沿触发时，写到EAGAIN之后再关注POLLOUT，否则可能等不到边沿
+		if (channel_->edgeTriggered())
 		{
-			// 在highWaterMarkCallback_中我们可以把该连接断开，这要看该回调函数怎么实现
-			loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+			writeUntilBlocked();
+			if (outputBuffer_.empty())
+			{
+				return;
+			}
 		}
+		channel_->enableWriting();
+	}
+}
+
+void TcpConnection::flushCorked()
+{
+	getLoop()->assertInLoopThread();
+	corked_ = false;
+	if (state_ == kDisconnected || channel_->isWriting())
+	{
+		return;
+	}
+	if (channel_->edgeTriggered())
+	{
+		writeUntilBlocked();
+	}
+	else
+	{
+		writeOutput();
+	}
+	if (!outputBuffer_.empty())
+	{
+		channel_->enableWriting();
+	}
+}
 
-		// 把未发送的数据添加到output buffer中
-		outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
+void TcpConnection::checkHighWaterMark(size_t remaining)
+{
+	size_t oldLen = outputBuffer_.readableBytes();	// 当前output buffer中的数据
+	const int64_t newLen = static_cast<int64_t>(oldLen + remaining);
+	if (newLen > peakOutputBytes_.load(std::memory_order_relaxed))
+	{
+		peakOutputBytes_.store(newLen, std::memory_order_relaxed);
+	}
+	if (oldLen + remaining >= highWaterMark_
+		&& aboveHighWaterSince_.load(std::memory_order_relaxed) == 0)
+	{
+		aboveHighWaterSince_.store(Timestamp::now().microSecondsSinceEpoch(),
+			std::memory_order_relaxed);
+	}
 
-		// output buffer中有数据了，我们就要关注POLLOUT事件，如果没有关注我们就要立即关注
-		if (!channel_->isWriting())
-		{
-			channel_->enableWriting();	// 关注POLLOUT事件
-		}
+	if (backpressureHigh_ > 0 && !backpressured_ && oldLen + remaining >= backpressureHigh_)
+	{
+		pauseSource();
+	}
+
+	//  如果操作highWaterMark_(高水位标),回调highWaterMarkCallback_
+	if (oldLen + remaining >= highWaterMark_
+		&& oldLen < highWaterMark_
+		&& highWaterMarkCallback_)
+	{
+		// 在highWaterMarkCallback_中我们可以把该连接断开，这要看该回调函数怎么实现
+		getLoop()->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
 	}
 }
 
@@ -227,14 +647,15 @@ void TcpConnection::shutdown()
 		setState(kDisconnecting);
 		// FIXME: shared_from_this()?
 		// 在当前IO线程当中调用shutdownInLoop，可以把this指针改为shared_from_this
-		loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+		runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
 	}
 }
 
 void TcpConnection::shutdownInLoop()
 {
-	loop_->assertInLoopThread();
-	if (!channel_->isWriting())
+	getLoop()->assertInLoopThread();
+	// 还有等待合并发送的数据时，由flushCorked()发送完后再关闭
+	if (!channel_->isWriting() && !corked_)
 	{
 		// Tcp套接字是全双工的
 		// 只有处于不关注POLLOUT事件(可写事件)，我们才可以关闭该连接，
@@ -274,7 +695,7 @@ void TcpConnection::forceClose()
 	if (state_ == kConnected || state_ == kDisconnecting)
 	{
 		setState(kDisconnecting);
-		loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+		queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
 	}
 }
 
@@ -283,7 +704,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 	if (state_ == kConnected || state_ == kDisconnecting)
 	{
 		setState(kDisconnecting);
-		loop_->runAfter(
+		getLoop()->runAfter(
 			seconds,
 			makeWeakCallback(shared_from_this(),
 				&TcpConnection::forceClose));  // not forceCloseInLoop to avoid race condition
@@ -292,7 +713,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 
 void TcpConnection::forceCloseInLoop()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	if (state_ == kConnected || state_ == kDisconnecting)
 	{
 		// as if we received 0 byte in handleRead();
@@ -322,29 +743,61 @@ void TcpConnection::setTcpNoDelay(bool on)
 	socket_->setTcpNoDelay(on);
 }
 
+void TcpConnection::setEdgeTriggered(bool on)
+{
+	assert(state_ == kConnecting);
+	channel_->setEdgeTriggered(on);
+}
+
+bool TcpConnection::edgeTriggered() const
+{
+	return channel_->edgeTriggered();
+}
+
+bool TcpConnection::setZeroCopy(bool on, size_t threshold)
+{
+	if (!socket_->setZeroCopy(on))
+	{
+		return false;
+	}
+	// outputBuffer_只能在IO线程中访问
+	runInLoop(std::bind(&TcpConnection::setZeroCopyInLoop, this, on ? threshold : 0));
+	return true;
+}
+
+void TcpConnection::setZeroCopyInLoop(size_t threshold)
+{
+	getLoop()->assertInLoopThread();
+	outputBuffer_.setZeroCopyThreshold(threshold);
+}
+
 void TcpConnection::startRead()
 {
-	loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+	runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	if (!reading_ || !channel_->isReading())
 	{
-		channel_->enableReading();
+		// 被背压暂停时只记下来，恢复时再关注可读事件
+		if (throttles_ == 0)
+		{
+			channel_->enableReading();
+		}
 		reading_ = true;
 	}
 }
 
 void TcpConnection::stopRead()
 {
-	loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+	runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	if (reading_ || channel_->isReading())
 	{
 		channel_->disableReading();
@@ -352,10 +805,326 @@ void TcpConnection::stopReadInLoop()
 	}
 }
 
+void TcpConnection::setBackpressure(size_t highMark, size_t lowMark, const TcpConnectionPtr& source)
+{
+	getLoop()->assertInLoopThread();
+	assert(highMark == 0 || lowMark < highMark);
+	if (backpressured_)
+	{
+		resumeSource();
+	}
+	backpressureHigh_ = highMark;
+	backpressureLow_ = lowMark;
+	backpressureSource_ = source ? source : shared_from_this();
+	if (highMark > 0 && outputBuffer_.readableBytes() >= highMark)
+	{
+		pauseSource();
+	}
+}
+
+// source可能属于另一个EventLoop，在它的IO线程中暂停读
+void TcpConnection::pauseSource()
+{
+	backpressured_ = true;
+	TcpConnectionPtr source(backpressureSource_.lock());
+	if (source)
+	{
+		source->runInLoop(std::bind(&TcpConnection::throttleInLoop, source));
+	}
+}
+
+void TcpConnection::resumeSource()
+{
+	backpressured_ = false;
+	TcpConnectionPtr source(backpressureSource_.lock());
+	if (source)
+	{
+		source->runInLoop(std::bind(&TcpConnection::unthrottleInLoop, source));
+	}
+}
+
+void TcpConnection::throttleInLoop()
+{
+	getLoop()->assertInLoopThread();
+	if (++throttles_ == 1 && state_ != kDisconnected && channel_->isReading())
+	{
+		channel_->disableReading();
+	}
+}
+
+void TcpConnection::unthrottleInLoop()
+{
+	getLoop()->assertInLoopThread();
+	assert(throttles_ > 0);
+	if (--throttles_ == 0 && state_ != kDisconnected && reading_ && !channel_->isReading())
+	{
+		channel_->enableReading();
+	}
+}
+
+void TcpConnection::resumeReadingInLoop()
+{
+	getLoop()->assertInLoopThread();
+	if (memoryPaused_)
+	{
+		memoryPaused_ = false;
+		unthrottleInLoop();
+	}
+}
+
+void TcpConnection::moveToLoop(EventLoop* loop, const MoveCallback& cb)
+{
+	// 先让queueInLoop()改用连接自己的队列，移动结束之前的调用都不会乱序
+	moving_.fetch_add(1);
+	// 总是排队，不在本连接的事件处理中途移走
+	queueInLoop(std::bind(&TcpConnection::moveInLoop, shared_from_this(), loop, cb));
+}
+
+// 在原来的IO线程中从poller摘下来，缓冲区的存储还给原来的内存池
+void TcpConnection::moveInLoop(EventLoop* loop, const MoveCallback& cb)
+{
+	getLoop()->assertInLoopThread();
+	const bool idle = state_ == kConnected
+		&& inputBuffer_.readableBytes() == 0
+		&& outputBuffer_.empty()
+		&& outputBuffer_.numZeroCopyPending() == 0
+		&& !corked_;
+	if (loop == getLoop() || !idle)
+	{
+		LOG_DEBUG << "TcpConnection::moveInLoop [" << name_ << "] - "
+			<< (idle ? "already in loop" : "not idle");
+		moveDone();
+		if (cb)
+		{
+			cb(shared_from_this(), false);
+		}
+		return;
+	}
+
+	if (BufferPool::hasStorage(inputBuffer_))
+	{
+		getLoop()->bufferPool()->release(&inputBuffer_);
+	}
+	channel_->disableAll();
+	channel_->remove();
+	getLoop()->adjustConnections(-1);
+	if (idleSlot_ >= 0)
+	{
+		getLoop()->idleWheel()->remove(this);
+	}
+
+	channel_->setOwnerLoop(loop);
+	outputBuffer_.setPool(loop->bufferPool());
+	loop->adjustConnections(1);
+	// 之后的跨线程调用都转到新的loop，已经排队的由doPendingFunctors()转过去
+	readIteration_ = -1;	// 新loop的循环计数和原来的无关
+	loop_.store(loop, std::memory_order_release);
+	loop->queueInLoop(std::bind(&TcpConnection::moveArrived, shared_from_this(), cb));
+}
+
+void TcpConnection::moveArrived(const MoveCallback& cb)
+{
+	getLoop()->assertInLoopThread();
+	// 途中可能已经被关闭
+	if (state_ == kConnected && reading_ && throttles_ == 0 && !channel_->isReading())
+	{
+		channel_->enableReading();
+	}
+	if (state_ == kConnected && nextIdleDeadline() >= 0)
+	{
+		getLoop()->idleWheel()->update(this, Timestamp::now());
+	}
+	LOG_DEBUG << "TcpConnection::moveArrived [" << name_ << "] fd=" << channel_->fd();
+	moveDone();
+	if (cb)
+	{
+		cb(shared_from_this(), state_ == kConnected);
+	}
+}
+
+// 移动结束，连接自己的队列排空之后queueInLoop()恢复直接投递
+void TcpConnection::moveDone()
+{
+	getLoop()->assertInLoopThread();
+	MutexLockGuard lock(pendingMutex_);
+	++movesDone_;
+	// 否则由排队的doPendingFunctors()执行完再减
+	if (!pendingQueued_)
+	{
+		moving_.fetch_sub(movesDone_);
+		movesDone_ = 0;
+		pendingFenced_ = false;
+	}
+}
+
+void TcpConnection::setIdleTimeout(double readIdle, double writeIdle, double allIdle)
+{
+	runInLoop(std::bind(&TcpConnection::setIdleTimeoutInLoop, shared_from_this(),
+		readIdle, writeIdle, allIdle));
+}
+
+void TcpConnection::setIdleTimeoutInLoop(double readIdle, double writeIdle, double allIdle)
+{
+	getLoop()->assertInLoopThread();
+	const double seconds[] = { readIdle, writeIdle, allIdle };
+	const Timestamp now(Timestamp::now());
+	for (int i = 0; i < 3; ++i)
+	{
+		idleTimeouts_[i] = seconds[i] > 0.0
+			? std::max<int64_t>(static_cast<int64_t>(seconds[i] * Timestamp::kMicroSecondsPerSecond), 1)
+			: 0;
+		idleSince_[i] = now.microSecondsSinceEpoch();
+	}
+	// 还没有建立的连接在connectEstablished()中放进去
+	if (state_ == kConnected)
+	{
+		getLoop()->idleWheel()->update(this, now);
+	}
+}
+
+int64_t TcpConnection::idleDeadline(IdleEvent event) const
+{
+	int64_t last = 0;
+	switch (event)
+	{
+	case kReadIdle:
+		last = lastReceiveTime_.load(std::memory_order_relaxed);
+		break;
+	case kWriteIdle:
+		last = lastSendTime_.load(std::memory_order_relaxed);
+		break;
+	case kAllIdle:
+		last = std::max(lastReceiveTime_.load(std::memory_order_relaxed),
+			lastSendTime_.load(std::memory_order_relaxed));
+		break;
+	}
+	return std::max(last, idleSince_[event]) + idleTimeouts_[event];
+}
+
+int64_t TcpConnection::nextIdleDeadline() const
+{
+	int64_t deadline = -1;
+	const IdleEvent events[] = { kReadIdle, kWriteIdle, kAllIdle };
+	for (IdleEvent event : events)
+	{
+		if (idleTimeouts_[event] > 0)
+		{
+			const int64_t d = idleDeadline(event);
+			deadline = deadline < 0 ? d : std::min(deadline, d);
+		}
+	}
+	return deadline;
+}
+
+void TcpConnection::runInLoop(std::function<void()> cb)
+{
+	if (getLoop()->isInLoopThread())
+	{
+		cb();
+	}
+	else
+	{
+		queueInLoop(std::move(cb));
+	}
+}
+
+// 平时直接投递给loop，和EventLoop::queueInLoop()的回调一样保持顺序，不加锁。
+// 有移动没有结束时回调放在连接自己的队列中，不随EventLoop的任务转发，所以连接移走时不会乱序
+void TcpConnection::queueInLoop(std::function<void()> cb)
+{
+	// 和moveToLoop()的moving_一起，要么这里看到移动，要么doPendingFunctors()等这次投递完
+	posting_.fetch_add(1);
+	if (moving_.load() == 0)
+	{
+		getLoop()->queueInLoop(std::move(cb));
+		posting_.fetch_sub(1);
+		return;
+	}
+	posting_.fetch_sub(1);
+
+	bool post = false;
+	{
+		MutexLockGuard lock(pendingMutex_);
+		// cb可能绑定了send(Buffer&&)的整个缓冲区，只移动不复制
+		pendingFunctors_.push_back(std::move(cb));
+		post = !pendingQueued_;
+		pendingQueued_ = true;
+	}
+	if (post)
+	{
+		getLoop()->queueInLoop(std::bind(&TcpConnection::doPendingFunctors, shared_from_this()));
+	}
+}
+
+void TcpConnection::doPendingFunctors()
+{
+	EventLoop* loop = getLoop();
+	if (!loop->isInLoopThread())
+	{
+		// 排队期间连接被moveToLoop()移走了，回调还在队列中，到新的loop中执行
+		loop->queueInLoop(std::bind(&TcpConnection::doPendingFunctors, shared_from_this()));
+		return;
+	}
+
+	// 执行期间pendingQueued_保持为真，新加入的不会另外投递，
+	// 否则连接移走后新的loop可能抢在这一批剩下的回调之前执行
+	bool fence = false;
+	std::vector<std::function<void()>> functors;
+	{
+		MutexLockGuard lock(pendingMutex_);
+		fence = !pendingFenced_;
+		pendingFenced_ = true;
+		if (!fence)
+		{
+			functors.swap(pendingFunctors_);
+		}
+	}
+	if (fence)
+	{
+		// 移动开始之前直接投递的回调可能排在这次后面，等它们投递完，
+		// 再排到它们后面，它们都在原来的loop中先执行
+		while (posting_.load() != 0)
+		{
+			sched_yield();
+		}
+		loop->queueInLoop(std::bind(&TcpConnection::doPendingFunctors, shared_from_this()));
+		return;
+	}
+	size_t i = 0;
+	while (i < functors.size())
+	{
+		functors[i++]();
+		if (getLoop() != loop)
+		{
+			// 这个回调把连接移走了，剩下的在新的loop中执行
+			break;
+		}
+	}
+	bool post = false;
+	{
+		MutexLockGuard lock(pendingMutex_);
+		pendingFunctors_.insert(pendingFunctors_.begin(),
+			std::make_move_iterator(functors.begin() + i),
+			std::make_move_iterator(functors.end()));
+		post = !pendingFunctors_.empty();
+		pendingQueued_ = post;
+		if (!post && movesDone_ > 0)
+		{
+			moving_.fetch_sub(movesDone_);
+			movesDone_ = 0;
+			pendingFenced_ = false;
+		}
+	}
+	if (post)
+	{
+		getLoop()->queueInLoop(std::bind(&TcpConnection::doPendingFunctors, shared_from_this()));
+	}
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	assert(state_ == kConnecting);//判断是否处于正在连接状态
 	setState(kConnected);//设置成已连接状态
 
@@ -365,6 +1134,14 @@ void TcpConnection::connectEstablished()
 	//关注这个通道的可读事件
 	//TcpConnection所对应的通道加入到Poller中关注
 	channel_->enableReading();
+	if (memoryBudget_)
+	{
+		memoryBudget_->addConnection(shared_from_this());
+	}
+	if (nextIdleDeadline() >= 0)
+	{
+		getLoop()->idleWheel()->update(this, Timestamp::now());
+	}
 
 	//回调connectionCallback，该回调函数是用户的回调函数
 	connectionCallback_(shared_from_this());
@@ -372,80 +1149,150 @@ void TcpConnection::connectEstablished()
 
 void TcpConnection::connectDestroyed()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	if (state_ == kConnected)
 	{
 		setState(kDisconnected);
 		channel_->disableAll();
+		// 和handleClose()一样，比如~TcpServer()拆掉的sink，不能让source一直停着
+		if (backpressured_)
+		{
+			resumeSource();
+		}
 
 		//回调用户的回调函数
 		connectionCallback_(shared_from_this());
 	}
+	if (memoryBudget_)
+	{
+		memoryBudget_->removeConnection(this, memoryCharged_.exchange(0));
+	}
+	if (idleSlot_ >= 0)
+	{
+		getLoop()->idleWheel()->remove(this);
+	}
 	channel_->remove();
+	getLoop()->adjustConnections(-1);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
+	readIteration_ = getLoop()->iteration();
+	BufferPool* pool = getLoop()->bufferPool();
+	size_t total = 0;
 	int savedErrno = 0;
-	//读取通道，把数据读到缓冲区inputBuffer_中
-	ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-	if (n > 0)
+	ssize_t n = 0;
+	// 一直读到套接字读空或者用完预算，剩下的数据等下一轮poll再读
+	while (total < readBudget_)
 	{
+		const size_t want = std::min(readSize_, readBudget_ - total);
+		if (inputBuffer_.readableBytes() == 0 && inputBuffer_.writableBytes() < want)
+		{
+			// 空的缓冲区直接换一块合适大小的存储，不用realloc
+			if (BufferPool::hasStorage(inputBuffer_))
+			{
+				pool->release(&inputBuffer_);
+			}
+			pool->acquire(&inputBuffer_, want);
+		}
+		//读取通道，把数据读到缓冲区inputBuffer_中
+		n = inputBuffer_.readFd(channel_->fd(), want, &savedErrno);
+		countRead(n, receiveTime);
+		if (n <= 0)
+		{
+			break;
+		}
+		total += n;
+		adjustReadSize(want, n);
 		//读取成功后，回调messageCallback_，把当前对象传给
 		messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+		// 没读满说明内核缓冲区已经读空了，省掉一次返回EAGAIN的read
+		// 回调中可能调用了stopRead()
+		if (implicit_cast<size_t>(n) < want || !channel_->isReading())
+		{
+			break;
+		}
 	}
-	else if (n == 0)
+
+	if (n == 0)
 	{
 		//read返回0，说明是客户端断开连接,下面是处理连接断开
 		handleClose();
 	}
-	else
+	// 边沿触发时，接着读的回调和新的边沿可能重复，读不到数据是正常的
+	else if (n < 0 && !((total > 0 || channel_->edgeTriggered())
+		&& (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)))
 	{
 		//处理错误
 		errno = savedErrno;
 		LOG_SYSERR << "TcpConnection::handleRead";
 		handleError();
 	}
+
+	// 消息都处理完了就把存储还给内存池，空闲连接不占用接收缓冲区
+	if (inputBuffer_.readableBytes() == 0 && BufferPool::hasStorage(inputBuffer_))
+	{
+		pool->release(&inputBuffer_);
+	}
+
+	// 边沿触发时用完预算还没读空，不会再有新的边沿，和水平触发一样下一轮循环接着读。
+	// 本轮处理通道时加入的回调本轮就会执行，所以到本轮最后才加入
+	if (n > 0 && total >= readBudget_ && channel_->edgeTriggered() && channel_->isReading())
+	{
+		TcpConnectionPtr self(shared_from_this());
+		getLoop()->runAtEndOfIteration([self]
+		{
+			self->queueInLoop(std::bind(&TcpConnection::continueReading, self));
+		});
+	}
+
+	chargeMemory();
+	// 内存紧张时，占用多的连接先停止读
+	if (memoryBudget_ && !memoryPaused_ && state_ == kConnected
+		&& memoryBudget_->pauseReading(shared_from_this(), memoryCharged_.load(std::memory_order_relaxed)))
+	{
+		memoryPaused_ = true;
+		throttleInLoop();
+	}
+}
+
+// 读满了就加倍，连续两次不到一半就减半，在kMinReadSize和kMaxReadSize之间
+// 小消息的连接一直用1k，大量上传的连接很快涨到64k
+void TcpConnection::adjustReadSize(size_t requested, size_t n)
+{
+	if (n == readSize_ && requested == readSize_)
+	{
+		readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+		shortReads_ = 0;
+	}
+	else if (n < readSize_ / 2)
+	{
+		if (++shortReads_ >= 2)
+		{
+			readSize_ = std::max(readSize_ / 2, kMinReadSize);
+			shortReads_ = 0;
+		}
+	}
+	else
+	{
+		shortReads_ = 0;
+	}
 }
 
 // 内核缓冲区有空间了，会回调该函数，即POLLOUT事件触发了
 void TcpConnection::handleWrite()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	if (channel_->isWriting())	// 如果通道出去关注POLLOUT事件，我们就把output buffer中的数据写入
 	{
-		ssize_t n = sockets::write(channel_->fd(),
-			outputBuffer_.peek(),
-			outputBuffer_.readableBytes());
-		// 一次写入不一定把数据全部写入
-		if (n > 0)
+		if (channel_->edgeTriggered())
 		{
-			// n > 0，我们要把output buffer中的数据移除已经发送的字节
-			outputBuffer_.retrieve(n);
-			if (outputBuffer_.readableBytes() == 0)	// 应用层发送缓冲区已全部清空，发送完毕
-			{
-				
-				channel_->disableWriting();	// 发送完毕，我们应该停止关注POLLOUT事件，以免出现busy loop
-				if (writeCompleteCallback_)	// 回调writeCompleteCallback_，没有数据了要回调。
-				{
-					loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-				}
-
-				//数据发送完毕，并且连接状态为kDisconnecting，即上层应用发送数据后要关闭连接
-				if (state_ == kDisconnecting)
-				{
-					shutdownInLoop();	// 关闭连接
-				}
-			}
+			writeUntilBlocked();
 		}
 		else
 		{
-			LOG_SYSERR << "TcpConnection::handleWrite";
-			// if (state_ == kDisconnecting)
-			// {
-			//   shutdownInLoop();
-			// }
+			writeOutput();
 		}
 	}
 	else
@@ -455,9 +1302,90 @@ void TcpConnection::handleWrite()
 	}
 }
 
+bool TcpConnection::writeOutput()
+{
+	int savedErrno = 0;
+	// 用一次writev把output buffer中的多个chunk写入，已发送的字节会从output buffer中移除
+	ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+	countWrite(n);
+	// 一次写入不一定把数据全部写入
+	// 0表示丢掉了读不出来的文件区间
+	if (n >= 0)
+	{
+		if (outputBuffer_.readableBytes() < highWaterMark_)
+		{
+			leaveHighWaterMark();
+		}
+		if (backpressured_ && outputBuffer_.readableBytes() <= backpressureLow_)
+		{
+			resumeSource();
+		}
+		if (outputBuffer_.empty())	// 应用层发送缓冲区已全部清空，发送完毕
+		{
+			if (channel_->isWriting())
+			{
+				channel_->disableWriting();	// 发送完毕，我们应该停止关注POLLOUT事件，以免出现busy loop
+			}
+			if (writeCompleteCallback_)	// 回调writeCompleteCallback_，没有数据了要回调。
+			{
+				getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+			}
+
+			//数据发送完毕，并且连接状态为kDisconnecting，即上层应用发送数据后要关闭连接
+			if (state_ == kDisconnecting)
+			{
+				shutdownInLoop();	// 关闭连接
+			}
+		}
+	}
+	else if (savedErrno != EWOULDBLOCK)
+	{
+		errno = savedErrno;
+		LOG_SYSERR << "TcpConnection::handleWrite";
+		// if (state_ == kDisconnecting)
+		// {
+		//   shutdownInLoop();
+		// }
+	}
+	chargeMemory();
+	return n >= 0;
+}
+
+// 边沿触发时要写到EAGAIN，之后才会有新的POLLOUT边沿
+void TcpConnection::writeUntilBlocked()
+{
+	while (!outputBuffer_.empty() && writeOutput())
+	{
+	}
+}
+
+void TcpConnection::continueReading()
+{
+	// 这一轮已经因为新的事件读过了，它会自己安排下一轮
+	if (state_ != kDisconnected && channel_->isReading()
+		&& readIteration_ != getLoop()->iteration())
+	{
+		handleRead(Timestamp::now());
+	}
+}
+
+void TcpConnection::chargeMemory()
+{
+	if (memoryBudget_)
+	{
+		const int64_t bytes = static_cast<int64_t>(inputBuffer_.readableBytes() + outputBuffer_.readableBytes());
+		const int64_t delta = bytes - memoryCharged_.load(std::memory_order_relaxed);
+		if (delta != 0)
+		{
+			memoryCharged_.store(bytes, std::memory_order_relaxed);
+			memoryBudget_->charge(delta);
+		}
+	}
+}
+
 void TcpConnection::handleClose()
 {
-	loop_->assertInLoopThread();
+	getLoop()->assertInLoopThread();
 	LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
 	assert(state_ == kConnected || state_ == kDisconnecting);
 	// we don't close fd, leave it to dtor, so we can find leaks easily.
@@ -465,6 +1393,12 @@ void TcpConnection::handleClose()
 	//设置状态
 	setState(kDisconnected);
 	channel_->disableAll();
+	leaveHighWaterMark();
+	// 不再写了，不能让source一直停着
+	if (backpressured_)
+	{
+		resumeSource();
+	}
 
 	//获取这个对象的shared_ptr指针
 	TcpConnectionPtr guardThis(shared_from_this());
@@ -478,8 +1412,48 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+	// MSG_ZEROCOPY的完成通知也通过POLLERR到来，它们不是错误
+	const bool completions = outputBuffer_.numZeroCopyPending() > 0
+		&& outputBuffer_.handleZeroCopyCompletions(channel_->fd()) > 0;
 	int err = sockets::getSocketError(channel_->fd());
+	if (completions && err == 0)
+	{
+		return;
+	}
 	LOG_ERROR << "TcpConnection::handleError [" << name_
 		<< "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
+
+void TcpConnection::countRead(ssize_t n, Timestamp receiveTime)
+{
+	addCounter(&readCalls_, 1);
+	if (n > 0)
+	{
+		addCounter(&bytesReceived_, n);
+		lastReceiveTime_.store(receiveTime.microSecondsSinceEpoch(), std::memory_order_relaxed);
+	}
+}
+
+// 发送时间取poll返回的时间，省一次gettimeofday
+void TcpConnection::countWrite(ssize_t n)
+{
+	addCounter(&writeCalls_, 1);
+	if (n > 0)
+	{
+		addCounter(&bytesSent_, n);
+		lastSendTime_.store(getLoop()->pollReturnTime().microSecondsSinceEpoch(),
+			std::memory_order_relaxed);
+	}
+}
+
+void TcpConnection::leaveHighWaterMark()
+{
+	const int64_t since = aboveHighWaterSince_.load(std::memory_order_relaxed);
+	if (since > 0)
+	{
+		int64_t elapsed = Timestamp::now().microSecondsSinceEpoch() - since;
+		addCounter(&highWaterMicroSeconds_, std::max<int64_t>(elapsed, 0));
+		aboveHighWaterSince_.store(0, std::memory_order_relaxed);
+	}
+}
@@ -1,19 +1,25 @@
 ﻿#ifndef MUDUO_NET_TCPCONNECTION_H
 #define MUDUO_NET_TCPCONNECTION_H
 
+#include "muduo/base/Mutex.h"
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
+#include "muduo/net/BufferChain.h"
 #include "muduo/net/InetAddress.h"
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include <boost/any.hpp>
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
+struct iovec;
 
 namespace muduo
 {
@@ -22,8 +28,24 @@ namespace muduo
 
 		class Channel;
 		class EventLoop;
+		class MemoryBudget;
 		class Socket;
 
+		/// A snapshot of the counters of a TcpConnection, see TcpConnection::stats().
+		// 连接的流量统计
+		struct TcpConnectionStats
+		{
+			Timestamp creationTime;
+			Timestamp lastReceiveTime;
+			Timestamp lastSendTime;
+			int64_t bytesReceived = 0;
+			int64_t bytesSent = 0;
+			int64_t readCalls = 0;		// read(2)调用次数
+			int64_t writeCalls = 0;		// write(2)/writev(2)/sendfile(2)调用次数
+			int64_t peakOutputBytes = 0;	// output buffer的最大值
+			double secondsAboveHighWaterMark = 0.0;	// output buffer高于高水位的累计时间
+		};
+
 		///
 		/// TCP connection, for both client and server usage.
 		///
@@ -42,7 +64,10 @@ namespace muduo
 				const InetAddress& peerAddr);
 			~TcpConnection();
 
-			EventLoop* getLoop() const { return loop_; }
+			/// The loop owning the connection, changed by moveToLoop().
+			/// Thread safe, but from another thread the connection may move
+			/// right after, runInLoop() and queueInLoop() below follow it.
+			EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
 			const string& name() const { return name_; }
 			const InetAddress& localAddress() const { return localAddr_; }
 			const InetAddress& peerAddress() const { return peerAddr_; }
@@ -52,21 +77,95 @@ namespace muduo
 			bool getTcpInfo(struct tcp_info*) const;
 			string getTcpInfoString() const;
 
-			// void send(string&& message); // C++11
+			/// Counters are updated in the loop thread, safe to read from any thread.
+			TcpConnectionStats stats() const;
+
+			// from other threads, message is moved to the loop without copying
+			void send(string&& message);
 			void send(const void* message, int len);
 			void send(const StringPiece& message);
-			// void send(Buffer&& message); // C++11
+			void send(const char* message);	// not ambiguous with send(string&&)
+			// gather-send, the pieces are sent in order without concatenating them first
+			// 例如header和body分开传入，在IO线程中用一次writev发出
+			void sendv(const StringPiece* pieces, size_t count);
+			void send(Buffer&& message);
 			void send(Buffer* message);  // this one will swap data
+			// fan-out without copying, the output buffer holds a reference to payload
+			// 同一个payload发给多个连接时只增加引用计数
+			void send(const Payload& payload);
+			// data must be allocated with new char[], it is deleted after being sent
+			void send(std::unique_ptr<char[]> data, size_t len);
+			/// Sends length bytes of file fd from offset with sendfile(2), in order
+			/// with the other sends. fd is dup()ed, the caller may close it at once.
+			/// writeCompleteCallback is called when it has been sent. A length of 0
+			/// sends nothing and calls nothing.
+			// 文件数据不经过用户空间
+			void sendFile(int fd, off_t offset, size_t length);
 			void shutdown(); // NOT thread safe, no simultaneous calling
 			// void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
 			void forceClose();
 			void forceCloseWithDelay(double seconds);
 			void setTcpNoDelay(bool on);
+			/// Sends Payloads of at least threshold bytes with MSG_ZEROCOPY,
+			/// each one is kept alive until the kernel is done with its pages.
+			/// Other sends are copied as usual.
+			/// @return false if the kernel doesn't support SO_ZEROCOPY
+			// 零拷贝发送，适合几百KB以上的大块数据
+			bool setZeroCopy(bool on, size_t threshold = 64 * 1024);
+			/// Holds back the sends made in the loop thread until the end of the
+			/// current loop iteration, then writes all of them with one writev(2).
+			/// Suits protocols which send a message in several pieces.
+			/// Call it in the loop thread, e.g. in the connection callback.
+			// 自动合并发送，减少系统调用次数
+			void setAutoCork(bool on) { autoCork_ = on; }
+			bool autoCork() const { return autoCork_; }
+			/// Registers the socket with EPOLLET: reads and writes go until EAGAIN,
+			/// and toggling POLLOUT around partial writes costs no epoll_ctl(2).
+			/// Call before connectEstablished(), TcpServer::setEdgeTriggered() does.
+			/// Level triggered pollers ignore it.
+			void setEdgeTriggered(bool on);
+			bool edgeTriggered() const;
 			// reading or not
 			void startRead();
 			void stopRead();
 			bool isReading() const { return reading_; }; // NOT thread safe, may race with start/stopReadInLoop
 
+			/// Moves the connection to loop without closing the socket. The channel
+			/// is registered with the poller of loop, the buffers take their storage
+			/// from its pool, and the callbacks run in its thread from then on.
+			/// Only an idle connection moves, one with nothing buffered for reading
+			/// or writing. cb runs afterwards in the loop owning the connection,
+			/// with true if it moved. Sends and other calls made from one thread
+			/// keep their order across the move. Thread safe. Connections of
+			/// TcpClient can't move.
+			// 连接迁移，在IO线程之间重新均衡负载，不断开客户端
+			void moveToLoop(EventLoop* loop, const MoveCallback& cb = MoveCallback());
+
+			/// Idle timeouts in seconds, 0 turns one off. Read idle expires when
+			/// nothing was received for that long, write idle when nothing was sent,
+			/// all idle when neither. On expiry the idle callback runs in the loop
+			/// thread, and again after each further period of idleness. Without
+			/// a callback the connection is closed. Checked about every 0.1 second
+			/// by the IdleWheel of the loop, traffic only updates a timestamp.
+			/// Thread safe, TcpServer::setIdleTimeout() sets it for new connections.
+			// 踢掉空闲连接，不用自己维护weak_ptr的时间轮
+			void setIdleTimeout(double readIdle, double writeIdle, double allIdle);
+			/// Call in the loop thread or before connectEstablished().
+			void setIdleCallback(const IdleCallback& cb) { idleCallback_ = cb; }
+
+			/// Bytes read from the socket per wakeup at most, default 256k.
+			/// handleRead() keeps reading until the socket is drained or the budget
+			/// is used up, one bulk sender can't starve the other connections of the loop.
+			/// At least kMinReadSize, smaller values are raised to it.
+			/// Call in the loop thread or before connectEstablished().
+			// 预算为0时一次也不读，handleRead()会当成对方关闭
+			void setReadBudget(size_t bytes) { readBudget_ = bytes < kMinReadSize ? kMinReadSize : bytes; }
+			size_t readBudget() const { return readBudget_; }
+			/// Bytes asked from the next read(2), doubled after a full read and
+			/// halved after two reads of less than half, between 1k and 64k.
+			/// Call in the loop thread.
+			size_t readSize() const { return readSize_; }
+
 			// 把一个未知类型赋值给context_
 			void setContext(const boost::any& context)
 			{
@@ -111,17 +210,39 @@ namespace muduo
 				highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark;
 			}
 
+			/// Flow control: stops reading from source once the output buffer of this
+			/// connection holds highMark bytes, and reads again when it drains to lowMark.
+			/// source is this connection by default. In a proxy it is the connection
+			/// whose data is relayed to this one, it may belong to another loop.
+			/// A source paused by several connections reads again after all of them drain.
+			/// Call it in the loop thread, highMark 0 turns it off.
+			// 内置的读背压，不用在高水位回调里自己stopRead/startRead
+			void setBackpressure(size_t highMark, size_t lowMark,
+				const TcpConnectionPtr& source = TcpConnectionPtr());
+			/// True while this connection keeps its source from reading.
+			bool isBackpressured() const { return backpressured_; }
+
+			/// Bytes held in the input and output buffers, as charged to the
+			/// MemoryBudget. Updated in the loop thread, safe to read from any thread.
+			int64_t memoryCharged() const { return memoryCharged_.load(std::memory_order_relaxed); }
+
 			/// Advanced interface
+			/// The buffers give their storage back to EventLoop::bufferPool()
+			/// when drained, they allocate again on the next append.
 			Buffer* inputBuffer()
 			{
 				return &inputBuffer_;
 			}
 
-			Buffer* outputBuffer()
+			BufferChain* outputBuffer()
 			{
 				return &outputBuffer_;
 			}
 
+			/// Internal use only.
+			// TcpServer在connectEstablished()之前设置
+			void setMemoryBudget(MemoryBudget* budget) { memoryBudget_ = budget; }
+
 			/// Internal use only.
 			//只能用于内部使用
 			void setCloseCallback(const CloseCallback& cb)
@@ -129,6 +250,16 @@ namespace muduo
 				closeCallback_ = cb;
 			}
 
+			/// Internal use only.
+			/// EventLoop::runInLoop() and queueInLoop() of getLoop(), but cb runs in
+			/// the loop owning the connection when it runs, see moveToLoop().
+			/// Functors queued by one thread run in the order queued, also when
+			/// the connection moves in between. They are posted straight to the
+			/// loop, only while a move is in flight they wait in a queue of the
+			/// connection.
+			void runInLoop(std::function<void()> cb);
+			void queueInLoop(std::function<void()> cb);
+
 			// called when TcpServer accepts a new connection
 			void connectEstablished();   // should be called only once
 
@@ -138,16 +269,41 @@ namespace muduo
 			void connectDestroyed();  // should be called only once
 
 		private:
+			friend class IdleWheel;
+			friend class MemoryBudget;
+
+			static const size_t kMinReadSize = Buffer::kInitialSize;
+			static const size_t kMaxReadSize = 64 * 1024;
+			static const size_t kDefaultReadBudget = 256 * 1024;
+
 			//连接状态
 			enum StateE { kDisconnected/*关闭连接*/, kConnecting/*正在连接*/, kConnected/*连接成功*/, kDisconnecting/*正在关闭连接*/ };
 			void handleRead(Timestamp receiveTime);
+			void continueReading();
 			void handleWrite();
 			void handleClose();
 			void handleError();
+			void adjustReadSize(size_t requested, size_t n);
 
-			// void sendInLoop(string&& message);
 			void sendInLoop(const StringPiece& message);
 			void sendInLoop(const void* message, size_t len);
+			void sendInLoop(const struct iovec* iov, int iovcnt);
+			void sendInLoop(Buffer* buf);
+			void sendBufferInLoop(Buffer& buf);
+			void sendInLoop(const Payload& payload);
+			void sendFileInLoop(const FileRegionPtr& file);
+			// write directly when nothing is queued, return false if the data should be dropped
+			bool writeDirectly(const struct iovec* iov, int iovcnt, size_t len, size_t* nwrote,
+				const Payload* zeroCopy = NULL);
+			void setZeroCopyInLoop(size_t threshold);
+			void startWriting();
+			bool writeOutput();
+			void writeUntilBlocked();
+			void flushCorked();
+			void countRead(ssize_t n, Timestamp receiveTime);
+			void countWrite(ssize_t n);
+			void leaveHighWaterMark();
+			void checkHighWaterMark(size_t remaining);
 			void shutdownInLoop();
 			// void shutdownAndForceCloseInLoop(double seconds);
 			void forceCloseInLoop();
@@ -155,11 +311,39 @@ namespace muduo
 			const char* stateToString() const;
 			void startReadInLoop();
 			void stopReadInLoop();
-
-			EventLoop* loop_;//所属EventLoop
+			void pauseSource();
+			void resumeSource();
+			void throttleInLoop();
+			void unthrottleInLoop();
+			void chargeMemory();
+			void resumeReadingInLoop();
+			void moveInLoop(EventLoop* loop, const MoveCallback& cb);
+			void moveArrived(const MoveCallback& cb);
+			void moveDone();
+			void doPendingFunctors();
+			void setIdleTimeoutInLoop(double readIdle, double writeIdle, double allIdle);
+			int64_t idleDeadline(IdleEvent event) const;
+			// 最早的空闲超时时间，-1表示都没有打开
+			int64_t nextIdleDeadline() const;
+
+			// 所属EventLoop，只在它的IO线程中由moveInLoop()改写，其他线程随时读取
+			std::atomic<EventLoop*> loop_;
+			// 还没有结束的moveToLoop()个数，不为0时queueInLoop()的回调放在下面的队列中
+			std::atomic<int> moving_;
+			// 正在直接投递给loop的queueInLoop()个数，移动开始前要等它们投递完
+			std::atomic<int> posting_;
+			// 移动途中queueInLoop()加入的回调先按顺序放在这里，由连接当时所属的loop执行，
+			// 不会被后来的超过
+			MutexLock pendingMutex_;
+			std::vector<std::function<void()>> pendingFunctors_ GUARDED_BY(pendingMutex_);
+			bool pendingQueued_ GUARDED_BY(pendingMutex_);	// 已经有doPendingFunctors()在loop中排队
+			bool pendingFenced_ GUARDED_BY(pendingMutex_);	// 之前直接投递的回调都已执行
+			int movesDone_ GUARDED_BY(pendingMutex_);	// 已经结束，还没有从moving_减去的移动
 			const string name_;//连接名称
 			StateE state_;  // 连接状态，FIXME: use atomic variable
 			bool reading_;
+			bool autoCork_;
+			bool corked_;	// output buffer中有等待本轮循环结束时发送的数据
 			// we don't expose those classes to client.
 			//
 			std::unique_ptr<Socket> socket_;
@@ -187,14 +371,43 @@ namespace muduo
 			//关闭连接回调函数，内部的断开连接回调函数,它是TcpServer中的removeConnection()这个函数
 			CloseCallback closeCallback_;
 			size_t highWaterMark_;	// 高水位标的最大值，当达到该值就要回调高水位标函数，断开连接，防止output buffer被撑爆
+			size_t backpressureHigh_;	// output buffer达到该值时暂停读source
+			size_t backpressureLow_;	// 降到该值时恢复读
+			std::weak_ptr<TcpConnection> backpressureSource_;
+			bool backpressured_;	// 是否暂停了source
+			int throttles_;		// 暂停读本连接的其他连接数(包括自己)
+			MemoryBudget* memoryBudget_;
+			std::atomic<int64_t> memoryCharged_;	// 已计入memoryBudget_的字节数
+			bool memoryPaused_;		// 因内存压力暂停读
 			Buffer inputBuffer_;    // 应用层接收缓冲区
-			Buffer outputBuffer_;   // 应用层发送缓冲区   FIXME: use list<Buffer> as output buffer.
+			BufferChain outputBuffer_;   // 应用层发送缓冲区，由多个Buffer串成，handleWrite中用writev发送
+			size_t readSize_;		// 下次read(2)读多少字节，根据最近几次读取的结果自适应调整
+			int shortReads_;		// 连续读不满readSize_一半的次数
+			size_t readBudget_;		// 每次唤醒最多读取的字节数
+			int64_t readIteration_;	// 上次handleRead()所在的循环，每轮最多读一次预算
 
 			boost::any context_;    //可以与外界的任意类型的对象进行绑定，能够接收任意类型的对象
 									//context_在muduo中用在了httpserver中
 
-			// FIXME: creationTime_, lastReceiveTime_
-			//        bytesReceived_, bytesSent_
+			// 统计，只在IO线程中修改，时间都是microseconds since epoch
+			const Timestamp creationTime_;
+			std::atomic<int64_t> lastReceiveTime_;
+			std::atomic<int64_t> lastSendTime_;
+			std::atomic<int64_t> bytesReceived_;
+			std::atomic<int64_t> bytesSent_;
+			std::atomic<int64_t> readCalls_;
+			std::atomic<int64_t> writeCalls_;
+			std::atomic<int64_t> peakOutputBytes_;
+			std::atomic<int64_t> highWaterMicroSeconds_;	// 不含正在进行的这一段
+			std::atomic<int64_t> aboveHighWaterSince_;		// 0表示低于高水位
+
+			// 空闲超时，由所属loop的IdleWheel检查，下标是IdleEvent，时间都是microseconds
+			int64_t idleTimeouts_[3];	// 0表示不检查
+			int64_t idleSince_[3];		// 开始检查或者上次触发的时间
+			IdleCallback idleCallback_;
+			int idleSlot_;		// 在IdleWheel中的位置，-1表示不在
+			TcpConnection* idlePrev_;
+			TcpConnection* idleNext_;
 		};
 
 		typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -8,12 +8,16 @@
 
 #include "muduo/net/TcpServer.h"
 
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/Acceptor.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/MemoryBudget.h"
 #include "muduo/net/SocketsOps.h"
 
+#include <algorithm>
+
 #include <stdio.h>  // snprintf
 
 using namespace muduo;
@@ -24,29 +28,69 @@ TcpServer::TcpServer(EventLoop* loop,
 	const string& nameArg,
 	Option option)
 	: loop_(CHECK_NOTNULL(loop)),//检查loop不是空指针
+	listenAddr_(listenAddr),
 	ipPort_(listenAddr.toIpPort()),//端口号
 	name_(nameArg),//名称
 	acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),// Acceptor对象
+	acceptMode_(kSingleAcceptor),
+	acceptInIoThreads_(false),
+	acceptBudget_(1),
 	threadPool_(new EventLoopThreadPool(loop, name_)),	// 构造一个EventLoopThreadPool对象，这个loop就是MainReactor
 	connectionCallback_(defaultConnectionCallback),
 	messageCallback_(defaultMessageCallback),
-	nextConnId_(1)
+	nextConnId_(1),
+	memoryBudget_(NULL),
+	edgeTriggered_(false),
+	incomingCpuSteering_(false),
+	rebalanceInterval_(0),
+	readIdle_(0),
+	writeIdle_(0),
+	allIdle_(0)
 {
 	//_1对应的是socket文件描述符，_2对应的是对等方的地址(InetAddrss)
 	acceptor_->setNewConnectionCallback(
 		std::bind(&TcpServer::newConnection, this, _1, _2));
+	acceptor_->setBatchEndCallback(
+		std::bind(&TcpServer::establishAccepted, this));
 }
 
 TcpServer::~TcpServer()
 {
 	loop_->assertInLoopThread();
 	LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+	if (rebalanceInterval_ > 0 && started_.get())
+	{
+		loop_->cancel(rebalanceTimer_);
+	}
+
+	if (acceptInIoThreads_)
+	{
+		// 在各个IO线程中停止accept并销毁它的连接，之后不会再有回调进来
+		std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+		for (size_t i = 0; i < loops.size(); ++i)
+		{
+			CountDownLatch latch(1);
+			loops[i]->runInLoop([this, i, &loops, &latch]
+			{
+				stopLoopAcceptor(i, loops[i]);
+				latch.countDown();
+			});
+			latch.wait();
+		}
+	}
 
-	for (auto& item : connections_)
+	ConnectionMap connections;
+	for (const auto& shard : shards_)
+	{
+		MutexLockGuard lock(shard->mutex);
+		connections.insert(shard->connections.begin(), shard->connections.end());
+		shard->connections.clear();
+	}
+	for (auto& item : connections)
 	{
 		TcpConnectionPtr conn(item.second);
 		item.second.reset();
-		conn->getLoop()->runInLoop(
+		conn->runInLoop(
 			std::bind(&TcpConnection::connectDestroyed, conn));
 	}
 }
@@ -58,20 +102,96 @@ void TcpServer::setThreadNum(int numThreads)
 	threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setLoopSelection(EventLoopThreadPool::LoopSelection selection)
+{
+	threadPool_->setLoopSelection(selection);
+}
+
 //该函数多次调用是无害的
 //该函数可以跨线程调用
 void TcpServer::start()
 {
 	if (started_.getAndSet(1) == 0)
 	{
+		// 没有IO线程时就是kSingleAcceptor
+		acceptInIoThreads_ = acceptMode_ != kSingleAcceptor && threadPool_->numThreads() > 0;
 		// 启动线程，可以传递一个线程初始化的函数，这个初始化函数通过setThreadInitCallback()来设置
 		threadPool_->start(threadInitCallback_);
+		// 每个IO线程一份连接表，没有IO线程时只有loop_一份。开始accept之前建好
+		shardLoops_ = threadPool_->getAllLoops();
+		for (size_t i = 0; i < shardLoops_.size(); ++i)
+		{
+			shards_.emplace_back(new ConnectionShard(static_cast<int>(i)));
+		}
 
 		// 断言判断是否处于侦听状态,如果不处于侦听状态，则调用执行监听listen
 		assert(!acceptor_->listenning());
-		// 让loop_调用listen函数
-		loop_->runInLoop(//get_pointer返回acceptor_的原生指针，到时候可以通过该原生指针调用listen函数
-			std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+		acceptor_->setAcceptBudget(acceptBudget_);
+		if (acceptInIoThreads_)
+		{
+			loop_->runInLoop(std::bind(&TcpServer::startLoopAcceptors, this));
+		}
+		else
+		{
+			// 让loop_调用listen函数
+			loop_->runInLoop(//get_pointer返回acceptor_的原生指针，到时候可以通过该原生指针调用listen函数
+				std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+		}
+		if (rebalanceInterval_ > 0)
+		{
+			rebalanceTimer_ = loop_->runEvery(rebalanceInterval_,
+				std::bind(&TcpServer::rebalance, this));
+		}
+	}
+}
+
+void TcpServer::startLoopAcceptors()
+{
+	loop_->assertInLoopThread();
+	std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+	if (acceptMode_ == kReusePortPerLoop)
+	{
+		// 没有SO_REUSEPORT的socket绑定着端口，其他socket就绑定不上
+		acceptor_.reset();
+	}
+	for (EventLoop* ioLoop : loops)
+	{
+		Acceptor* acceptor = acceptMode_ == kReusePortPerLoop
+			? new Acceptor(ioLoop, listenAddr_, true)
+			: new Acceptor(ioLoop, acceptor_->fd());
+		acceptor->setNewConnectionCallback(
+			std::bind(&TcpServer::newConnectionInLoop, this, ioLoop, _1, _2));
+		acceptor->setAcceptBudget(acceptBudget_);
+		loopAcceptors_.emplace_back(acceptor);
+		ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor));
+	}
+}
+
+void TcpServer::stopLoopAcceptor(size_t index, EventLoop* loop)
+{
+	loop->assertInLoopThread();
+	loopAcceptors_[index].reset();
+	// 移过来的连接在别的分片中
+	std::vector<TcpConnectionPtr> conns;
+	for (const auto& shard : shards_)
+	{
+		MutexLockGuard lock(shard->mutex);
+		for (ConnectionMap::iterator it = shard->connections.begin(); it != shard->connections.end(); )
+		{
+			if (it->second->getLoop() == loop)
+			{
+				conns.push_back(it->second);
+				it = shard->connections.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	for (const TcpConnectionPtr& conn : conns)
+	{
+		conn->connectDestroyed();
 	}
 }
 
@@ -79,11 +199,93 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
 	loop_->assertInLoopThread();
-	//采用轮询的方法把新的连接加入到线程池中，这样使得每个线程所维护的socket都是均匀的
-	EventLoop* ioLoop = threadPool_->getNextLoop();
+	//按选择策略（默认轮询）把新的连接加入到线程池中，这样使得每个线程所维护的socket都是均匀的
+	EventLoop* ioLoop = NULL;
+	if (incomingCpuSteering_)
+	{
+		ioLoop = threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd));
+	}
+	if (ioLoop == NULL)
+	{
+		ioLoop = threadPool_->getNextLoop();
+	}
+	TcpConnectionPtr conn(addConnection(ioLoop, sockfd, peerAddr));
+	if (!conn)
+	{
+		return;
+	}
+	if (acceptBudget_ > 1)
+	{
+		// 这次accept完之后一起交给IO线程
+		accepted_[ioLoop].push_back(conn);
+	}
+	else
+	{
+		//我们不能直接使用conn对象调用用connectEstablished()进行连接建立，我们要在它所属的IO线程中调用
+		//然后调用conn它的TcpConnection::connectEstablished
+		ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+	}
+}
+
+namespace
+{
+	void establishAll(const std::vector<TcpConnectionPtr>& conns)
+	{
+		for (const TcpConnectionPtr& conn : conns)
+		{
+			conn->connectEstablished();
+		}
+	}
+}
+
+void TcpServer::establishAccepted()
+{
+	loop_->assertInLoopThread();
+	for (auto& item : accepted_)
+	{
+		if (!item.second.empty())
+		{
+			// 每个IO线程一个functor，只唤醒一次
+			std::vector<TcpConnectionPtr> conns;
+			conns.swap(item.second);
+			item.first->runInLoop(std::bind(establishAll, std::move(conns)));
+		}
+	}
+}
+
+// 在accept它的IO线程中服务，不用转到别的线程
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+	ioLoop->assertInLoopThread();
+	TcpConnectionPtr conn(addConnection(ioLoop, sockfd, peerAddr));
+	if (conn)
+	{
+		conn->connectEstablished();
+	}
+}
+
+TcpConnectionPtr TcpServer::addConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+	if (memoryBudget_ && !memoryBudget_->admit())
+	{
+		LOG_WARN << "TcpServer::newConnection [" << name_
+			<< "] - refuse " << peerAddr.toIpPort() << ", memory budget exceeded";
+		sockets::close(sockfd);
+		return TcpConnectionPtr();
+	}
+	ConnectionShard* shard = shardOf(ioLoop);
 	char buf[64];
-	snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-	++nextConnId_;
+	if (acceptInIoThreads_)
+	{
+		// 各个IO线程分别编号，不用加锁
+		snprintf(buf, sizeof buf, "-%s#%d-%d", ipPort_.c_str(), shard->index, shard->nextConnId);
+		++shard->nextConnId;
+	}
+	else
+	{
+		snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
+		++nextConnId_;
+	}
 	string connName = name_ + buf;
 
 	LOG_INFO << "TcpServer::newConnection [" << name_
@@ -100,38 +302,209 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 		localAddr,
 		peerAddr));
 	//把conn放入列表中
-	connections_[connName] = conn;
+	{
+		MutexLockGuard lock(shard->mutex);
+		shard->connections[connName] = conn;
+	}
 	conn->setConnectionCallback(connectionCallback_);
 	conn->setMessageCallback(messageCallback_);
 	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	conn->setMemoryBudget(memoryBudget_);
+	conn->setEdgeTriggered(edgeTriggered_);
+	if (readIdle_ > 0 || writeIdle_ > 0 || allIdle_ > 0)
+	{
+		conn->setIdleCallback(idleCallback_);
+		conn->setIdleTimeout(readIdle_, writeIdle_, allIdle_);
+	}
 
 	conn->setCloseCallback(
 		std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+	return conn;
+}
 
-	//我们不能直接使用conn对象调用用connectEstablished()进行连接建立，我们要在它所属的IO线程中调用
-	//然后调用conn它的TcpConnection::connectEstablished
-	ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+namespace
+{
+	void accumulate(TcpConnectionStats* total, const TcpConnectionStats& s)
+	{
+		if (s.creationTime.valid()
+			&& (!total->creationTime.valid() || s.creationTime < total->creationTime))
+		{
+			total->creationTime = s.creationTime;
+		}
+		total->lastReceiveTime = std::max(total->lastReceiveTime, s.lastReceiveTime);
+		total->lastSendTime = std::max(total->lastSendTime, s.lastSendTime);
+		total->bytesReceived += s.bytesReceived;
+		total->bytesSent += s.bytesSent;
+		total->readCalls += s.readCalls;
+		total->writeCalls += s.writeCalls;
+		total->peakOutputBytes = std::max(total->peakOutputBytes, s.peakOutputBytes);
+		total->secondsAboveHighWaterMark += s.secondsAboveHighWaterMark;
+	}
+}
+
+TcpServer::ConnectionShard* TcpServer::shardOf(EventLoop* loop) const
+{
+	for (size_t i = 0; i < shardLoops_.size(); ++i)
+	{
+		if (shardLoops_[i] == loop)
+		{
+			return shards_[i].get();
+		}
+	}
+	// moveToLoop()可以移到线程池以外的loop
+	return NULL;
+}
+
+size_t TcpServer::numConnections() const
+{
+	size_t n = 0;
+	for (const auto& shard : shards_)
+	{
+		MutexLockGuard lock(shard->mutex);
+		n += shard->connections.size();
+	}
+	return n;
+}
+
+TcpConnectionStats TcpServer::totalStats() const
+{
+	loop_->assertInLoopThread();
+	TcpConnectionStats total;
+	for (const auto& shard : shards_)
+	{
+		MutexLockGuard lock(shard->mutex);
+		accumulate(&total, shard->closedStats);
+		for (const auto& item : shard->connections)
+		{
+			accumulate(&total, item.second->stats());
+		}
+	}
+	return total;
+}
+
+TcpServer::ConnectionStatsList TcpServer::connectionStats() const
+{
+	loop_->assertInLoopThread();
+	ConnectionStatsList result;
+	for (const auto& shard : shards_)
+	{
+		MutexLockGuard lock(shard->mutex);
+		for (const auto& item : shard->connections)
+		{
+			result.push_back(std::make_pair(item.first, item.second->stats()));
+		}
+	}
+	return result;
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
+	if (acceptInIoThreads_)
+	{
+		// 每个IO线程accept时就在连接的IO线程中移除
+		removeConnectionInLoop(conn);
+		return;
+	}
 	// FIXME: unsafe
 	loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
-	loop_->assertInLoopThread();
+	assert(loop_->isInLoopThread() || conn->getLoop()->isInLoopThread());
 	LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
 		<< "] - connection " << conn->name();
 
-	//将channel对象重列表中移除
-	size_t n = connections_.erase(conn->name());
-	(void)n;
-	assert(n == 1);
-	EventLoop* ioLoop = conn->getLoop();
-	ioLoop->queueInLoop(
+	auto removeFrom = [&conn](ConnectionShard* shard)
+	{
+		MutexLockGuard lock(shard->mutex);
+		//将channel对象重列表中移除
+		if (shard->connections.erase(conn->name()) == 0)
+		{
+			return false;
+		}
+		// 连接已经关闭，计数不会再变
+		accumulate(&shard->closedStats, conn->stats());
+		return true;
+	};
+	// 多数连接没有移动过，在当前IO线程的分片中
+	ConnectionShard* current = shardOf(conn->getLoop());
+	bool removed = current && removeFrom(current);
+	for (size_t i = 0; !removed && i < shards_.size(); ++i)
+	{
+		if (shards_[i].get() != current)
+		{
+			removed = removeFrom(shards_[i].get());
+		}
+	}
+	(void)removed;
+	assert(removed);
+	conn->queueInLoop(
 		//将conn与TcpConnection::connectDestroyed相绑定产生一个Function对象，这时conn的引用会+1
 		std::bind(&TcpConnection::connectDestroyed, conn));
 }
 
+void TcpServer::rebalance()
+{
+	loop_->assertInLoopThread();
+	// 忙碌时间相差超过每秒100ms才移动
+	const int64_t kBusyImbalanceUs = 100 * 1000;
+	const int kMaxMoves = 16;
+	std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+	if (loops.size() < 2)
+	{
+		return;
+	}
+
+	const bool byBusy = threadPool_->loopSelection() == EventLoopThreadPool::kLeastBusy;
+	EventLoop* heaviest = loops[0];
+	EventLoop* lightest = loops[0];
+	for (EventLoop* loop : loops)
+	{
+		if (byBusy ? loop->recentBusyMicroseconds() > heaviest->recentBusyMicroseconds()
+			: loop->numConnections() > heaviest->numConnections())
+		{
+			heaviest = loop;
+		}
+		if (byBusy ? loop->recentBusyMicroseconds() < lightest->recentBusyMicroseconds()
+			: loop->numConnections() < lightest->numConnections())
+		{
+			lightest = loop;
+		}
+	}
+
+	int moves = 0;
+	if (byBusy)
+	{
+		// 不知道哪个连接忙，每次只移一个，下一个窗口再看效果
+		if (heaviest->recentBusyMicroseconds() - lightest->recentBusyMicroseconds() > kBusyImbalanceUs
+			&& heaviest->numConnections() > 1)
+		{
+			moves = 1;
+		}
+	}
+	else
+	{
+		moves = std::min((heaviest->numConnections() - lightest->numConnections()) / 2, kMaxMoves);
+	}
+
+	// 不空闲的连接不会移动，下次再试。先找heaviest自己的分片
+	const size_t first = shardOf(heaviest)->index;
+	for (size_t n = 0; moves > 0 && n < shards_.size(); ++n)
+	{
+		ConnectionShard* shard = shards_[(first + n) % shards_.size()].get();
+		MutexLockGuard lock(shard->mutex);
+		for (ConnectionMap::iterator it = shard->connections.begin();
+			moves > 0 && it != shard->connections.end(); ++it)
+		{
+			if (it->second->getLoop() == heaviest)
+			{
+				LOG_DEBUG << "TcpServer::rebalance [" << name_ << "] - move "
+					<< it->second->name() << " to " << lightest;
+				it->second->moveToLoop(lightest, rebalanceCallback_);
+				--moves;
+			}
+		}
+	}
+}
+
@@ -2,10 +2,15 @@
 #define MUDUO_NET_TCPSERVER_H
 
 #include "muduo/base/Atomic.h"
+#include "muduo/base/Mutex.h"
 #include "muduo/base/Types.h"
+#include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/TcpConnection.h"
+#include "muduo/net/TimerId.h"
 
 #include <map>
+#include <utility>
+#include <vector>
 
 namespace muduo
 {
@@ -14,7 +19,7 @@ namespace muduo
 
 		class Acceptor;
 		class EventLoop;
-		class EventLoopThreadPool;
+		class MemoryBudget;
 
 		///
 		/// TCP server, supports single-threaded and thread-pool models.
@@ -29,6 +34,12 @@ namespace muduo
 				kNoReusePort,
 				kReusePort,
 			};
+			enum AcceptMode
+			{
+				kSingleAcceptor,	// loop_ accept，再分给IO线程
+				kReusePortPerLoop,	// 每个IO线程一个SO_REUSEPORT的监听socket
+				kExclusivePerLoop,	// IO线程共用监听socket，EPOLLEXCLUSIVE
+			};
 
 			//TcpServer(EventLoop* loop, const InetAddress& listenAddr);
 			TcpServer(EventLoop* loop,
@@ -50,13 +61,41 @@ namespace muduo
 			///   this is the default value.
 			/// - 1 means all I/O in another thread.
 			/// - N means a thread pool with N threads, new connections
-			///   are assigned on a round-robin basis.
+			///   are assigned on a round-robin basis, see setLoopSelection().
 			void setThreadNum(int numThreads);
+			/// How new connections are assigned to the I/O threads.
+			/// Not thread safe, call it before start().
+			void setLoopSelection(EventLoopThreadPool::LoopSelection selection);
+			/// Assigns each new connection to the I/O thread pinned to the CPU
+			/// which handled its packets (SO_INCOMING_CPU), if there is one, so
+			/// that the socket stays in the cache of that CPU. Pin the threads with
+			/// threadPool()->setCpuAffinity(), ideally to the CPUs of the NIC queues.
+			/// Not thread safe, call it before start().
+			void setIncomingCpuSteering(bool on) { incomingCpuSteering_ = on; }
+			/// How connections are accepted, kSingleAcceptor by default: the loop
+			/// of the server accepts them and hands them to the I/O threads.
+			/// With kReusePortPerLoop each I/O thread listens on its own socket with
+			/// SO_REUSEPORT and serves the connections it accepts, the kernel spreads
+			/// them by a hash of the addresses. A stalled thread holds up its share.
+			/// With kExclusivePerLoop the I/O threads share one listening socket,
+			/// each watching it with EPOLLEXCLUSIVE, so a thread waiting in
+			/// epoll_wait(2) takes the connection. Either way accepting takes no
+			/// thread hop, and setLoopSelection() and setIncomingCpuSteering() don't
+			/// apply. Without I/O threads it's kSingleAcceptor.
+			/// Not thread safe, call it before start().
+			void setAcceptMode(AcceptMode mode) { acceptMode_ = mode; }
+			/// Accepts up to budget connections per wakeup of a listening socket,
+			/// until it has no more, 1 by default. With kSingleAcceptor the
+			/// connections accepted together go to each I/O thread in one functor,
+			/// one wakeup of the thread instead of one per connection. Helps when
+			/// many clients connect at once, e.g. reconnecting after a restart.
+			/// Not thread safe, call it before start().
+			void setAcceptBudget(int budget) { acceptBudget_ = budget; }
 			void setThreadInitCallback(const ThreadInitCallback& cb)
 			{
 				threadInitCallback_ = cb;
 			}
-			/// valid after calling start()
+			/// valid after calling start(), set the options of the pool before
 			std::shared_ptr<EventLoopThreadPool> threadPool()
 			{
 				return threadPool_;
@@ -91,31 +130,127 @@ namespace muduo
 				writeCompleteCallback_ = cb;
 			}
 
+			typedef std::vector<std::pair<string, TcpConnectionStats> > ConnectionStatsList;
+
+			/// Number of live connections.
+			/// Must be called in the loop thread.
+			size_t numConnections() const;
+
+			/// Counters summed over the live and the closed connections,
+			/// peakOutputBytes is the largest one, times are the latest.
+			/// Must be called in the loop thread.
+			TcpConnectionStats totalStats() const;
+
+			/// Counters of every live connection by name, e.g. to find the
+			/// clients with the largest output buffer.
+			/// Must be called in the loop thread.
+			ConnectionStatsList connectionStats() const;
+
+			/// Charges the buffers of every connection to budget, which may be
+			/// shared with other servers. New connections are refused while it is
+			/// above its reject ratio. budget must outlive the server.
+			/// Not thread safe, call it before start().
+			void setMemoryBudget(MemoryBudget* budget) { memoryBudget_ = budget; }
+
+			/// Registers new connections with EPOLLET, see TcpConnection::setEdgeTriggered().
+			/// Not thread safe, call it before start().
+			void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+			/// Every interval seconds, moves idle connections from the most loaded
+			/// I/O thread to the least loaded one, see TcpConnection::moveToLoop().
+			/// Load is the recent busy time with EventLoopThreadPool::kLeastBusy,
+			/// the number of connections otherwise. cb runs in the new loop of
+			/// each connection that moved. 0 turns it off, the default.
+			/// Not thread safe, call it before start().
+			void setRebalance(double interval, const MoveCallback& cb = MoveCallback())
+			{
+				rebalanceInterval_ = interval;
+				rebalanceCallback_ = cb;
+			}
+
+			/// Idle timeouts of new connections in seconds, 0 turns one off,
+			/// see TcpConnection::setIdleTimeout(). Without cb idle connections
+			/// are closed. Not thread safe, call it before start().
+			void setIdleTimeout(double readIdle, double writeIdle, double allIdle,
+				const IdleCallback& cb = IdleCallback())
+			{
+				readIdle_ = readIdle;
+				writeIdle_ = writeIdle;
+				allIdle_ = allIdle;
+				idleCallback_ = cb;
+			}
+
 		private:
 			/// Not thread safe, but in loop
 			   //连接到来时，会回调的函数
 			void newConnection(int sockfd, const InetAddress& peerAddr);
+			/// In ioLoop, with an Acceptor per I/O thread
+			void newConnectionInLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+			/// Returns NULL if refused
+			TcpConnectionPtr addConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+			/// Not thread safe, but in loop
+			void establishAccepted();
+			/// Not thread safe, but in loop
+			void startLoopAcceptors();
+			/// In the I/O thread of loop
+			void stopLoopAcceptor(size_t index, EventLoop* loop);
 			/// Thread safe.
 			void removeConnection(const TcpConnectionPtr& conn);
 			/// Not thread safe, but in loop
 			void removeConnectionInLoop(const TcpConnectionPtr& conn);
+			/// Not thread safe, but in loop
+			void rebalance();
 
 			//key:连接名称，value:连接对象的指针
 			typedef std::map<string, TcpConnectionPtr> ConnectionMap;
 
+			// 一个IO线程上建立的连接，accept和关闭只锁这一份，统计在查询时才合并。
+			// 连接移到别的IO线程后还留在原来的分片中
+			struct ConnectionShard
+			{
+				explicit ConnectionShard(int i) : index(i), nextConnId(1) {}
+
+				const int index;	// 下标同getAllLoops()
+				int nextConnId;		// 每个IO线程accept时只在这个IO线程中使用
+				mutable MutexLock mutex;
+				ConnectionMap connections GUARDED_BY(mutex);
+				TcpConnectionStats closedStats GUARDED_BY(mutex);	// 已关闭连接的统计之和
+			};
+
+			/// The shard of the connections established in loop, after start().
+			ConnectionShard* shardOf(EventLoop* loop) const;
+
 			EventLoop* loop_;  //acceptor_所属的EventLoop， the acceptor loop
+			const InetAddress listenAddr_;
 			const string ipPort_;	//服务端口
 			const string name_;	//服务名
 			std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor 接收连接的套接字
+			AcceptMode acceptMode_;
+			bool acceptInIoThreads_;	// start()中IO线程启动前确定，之后只读，各个线程都可以读
+			std::vector<std::unique_ptr<Acceptor> > loopAcceptors_;	// 每个IO线程一个，下标同getAllLoops()
+			int acceptBudget_;
+			// 一次accept到的连接，按IO线程分组，always in loop thread
+			std::map<EventLoop*, std::vector<TcpConnectionPtr> > accepted_;
 			std::shared_ptr<EventLoopThreadPool> threadPool_;//IO线程池
 			ConnectionCallback connectionCallback_;//连接到来的回调函数
 			MessageCallback messageCallback_;//消息到来的回调函数
 			WriteCompleteCallback writeCompleteCallback_;
 			ThreadInitCallback threadInitCallback_;
 			AtomicInt32 started_;			//是否已经启动
-			// always in loop thread
-			int nextConnId_;				//写一个连接ID
-			ConnectionMap connections_;	//连接列表
+			int nextConnId_;	// 只有一个Acceptor时使用，always in loop thread
+			// start()中建好之后不再改变，下标同getAllLoops()
+			std::vector<EventLoop*> shardLoops_;
+			std::vector<std::unique_ptr<ConnectionShard> > shards_;
+			MemoryBudget* memoryBudget_;	// 可以为NULL
+			bool edgeTriggered_;
+			bool incomingCpuSteering_;
+			double rebalanceInterval_;
+			MoveCallback rebalanceCallback_;
+			TimerId rebalanceTimer_;
+			double readIdle_;
+			double writeIdle_;
+			double allIdle_;
+			IdleCallback idleCallback_;
 		};
 
 	}  // namespace net
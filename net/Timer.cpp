@@ -5,6 +5,24 @@ using namespace muduo::net;
 
 AtomicInt64 Timer::s_numCreated_;
 
+void Timer::set(TimerCallback cb, Timestamp when, double interval, double slack)
+{
+	callback_ = std::move(cb);
+	expiration_ = when;
+	interval_ = interval;
+	slack_ = slack;
+	repeat_ = interval > 0.0;
+	canceled_ = false;
+	// 最后写序号，看到新序号的线程也看到了上面的字段
+	sequence_.store(s_numCreated_.incrementAndGet(), std::memory_order_release);
+}
+
+void Timer::clear()
+{
+	sequence_.store(0, std::memory_order_release);
+	callback_ = TimerCallback();
+}
+
 void Timer::restart(Timestamp now)
 {
 	//如果是重复的定时器
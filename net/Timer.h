@@ -7,25 +7,40 @@
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 
+#include <atomic>
+
 namespace muduo
 {
 	namespace net
 	{
 
+		class TimingWheel;
+
 		///
 		/// Internal class for timer event.
 		///
+		/// Timers are pooled by TimerQueue and reused, set() gives a timer
+		/// a new sequence, so a stale TimerId doesn't match it any more.
 		class Timer : noncopyable
 		{
 		public:
-			Timer(TimerCallback cb, Timestamp when, double interval)
-				: callback_(std::move(cb)),
-				expiration_(when),
-				interval_(interval),
-				repeat_(interval > 0.0),
-				sequence_(s_numCreated_.incrementAndGet())//先加后获取
+			Timer()
+				: interval_(0.0),
+				slack_(0.0),
+				repeat_(false),
+				canceled_(false),
+				sequence_(0),
+				tick_(0),
+				level_(-1),
+				slot_(0),
+				prev_(NULL),
+				next_(NULL)
 			{ }
 
+			void set(TimerCallback cb, Timestamp when, double interval, double slack);
+			// 放回内存池，释放回调函数持有的对象
+			void clear();
+
 			//run调用回调函数
 			void run() const
 			{
@@ -34,7 +49,13 @@ namespace muduo
 
 			Timestamp expiration() const { return expiration_; }
 			bool repeat() const { return repeat_; }
-			int64_t sequence() const { return sequence_; }
+			/// May run up to @c slack seconds after expiration().
+			double slack() const { return slack_; }
+			int64_t sequence() const { return sequence_.load(std::memory_order_acquire); }
+
+			/// Canceled while its callback was due, it won't run nor repeat.
+			void cancel() { canceled_ = true; }
+			bool canceled() const { return canceled_; }
 
 			//重启
 			void restart(Timestamp now);
@@ -42,11 +63,23 @@ namespace muduo
 			static int64_t numCreated() { return s_numCreated_.get(); }
 
 		private:
-			const TimerCallback callback_;	//定时器的回调函数
+			friend class TimingWheel;
+
+			TimerCallback callback_;	//定时器的回调函数
 			Timestamp expiration_;		//下一次的超时时刻，当超时时刻到来时，定时器的回调函数会被调用
-			const double interval_;		//超时时间间隔，如果是一次性定时器，该值为0
-			const bool repeat_;			//是否重复，如果为false是一次定时器
-			const int64_t sequence_;	//定时器序号
+			double interval_;		//超时时间间隔，如果是一次性定时器，该值为0
+			double slack_;			// 允许推迟的时间，用来合并唤醒
+			bool repeat_;			//是否重复，如果为false是一次定时器
+			bool canceled_;
+			// 其他线程addTimer()时写，cancel()在IO线程中读
+			std::atomic<int64_t> sequence_;	//定时器序号，0表示空闲
+
+			// 时间轮中的位置，只在IO线程中访问
+			int64_t tick_;
+			int level_;			// -1表示不在时间轮中
+			int slot_;
+			Timer* prev_;
+			Timer* next_;
 
 			static AtomicInt64 s_numCreated_;	//定时器计数，当前已经创建的定时器数量
 		};
@@ -17,6 +17,8 @@
 #include "muduo/net/Timer.h"
 #include "muduo/net/TimerId.h"
 
+#include <algorithm>
+
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -27,6 +29,34 @@ namespace muduo
 		namespace detail
 		{
 
+			// 时间轮的一个tick是1毫秒
+			const int64_t kMicroSecondsPerTick = 1000;
+
+			// 向上取整，定时器不会提前到期
+			int64_t tickOf(Timestamp when)
+			{
+				return (when.microSecondsSinceEpoch() + kMicroSecondsPerTick - 1) / kMicroSecondsPerTick;
+			}
+
+			// [first, last]中最整的tick，即末尾0最多的
+			// 窗口重叠的定时器大多落在同一个tick上
+			int64_t roundTick(int64_t first, int64_t last)
+			{
+				if (first >= last)
+				{
+					return first;
+				}
+				// first和last最高的不同位以下清零，结果仍然大于first
+				int bit = 63 - __builtin_clzll(static_cast<uint64_t>(first ^ last));
+				return last & ~((static_cast<int64_t>(1) << bit) - 1);
+			}
+
+			bool earlier(const Timer* lhs, const Timer* rhs)
+			{
+				return lhs->expiration() < rhs->expiration()
+					|| (lhs->expiration() == rhs->expiration() && lhs->sequence() < rhs->sequence());
+			}
+
 			int createTimerfd()
 			{
 				int timerfd = ::timerfd_create(CLOCK_MONOTONIC,
@@ -86,6 +116,16 @@ namespace muduo
 				}
 			}
 
+			void stopTimerfd(int timerfd)
+			{
+				struct itimerspec newValue;
+				memZero(&newValue, sizeof newValue);
+				if (::timerfd_settime(timerfd, 0, &newValue, NULL))
+				{
+					LOG_SYSERR << "timerfd_settime()";
+				}
+			}
+
 		}  // namespace detail
 	}  // namespace net
 }  // namespace muduo
@@ -98,7 +138,10 @@ TimerQueue::TimerQueue(EventLoop* loop)
 	: loop_(loop),
 	timerfd_(createTimerfd()),//创建定时器文件描述符
 	timerfdChannel_(loop, timerfd_),
-	timers_(),
+	wheel_(Timestamp::now().microSecondsSinceEpoch() / kMicroSecondsPerTick),
+	armedTick_(-1),
+	useTimerfd_(true),
+	numArms_(0),
 	callingExpiredTimers_(false)
 {
 	//当定时器通道可读事件产生的时候会回调handleRead成员函数
@@ -114,23 +157,22 @@ TimerQueue::~TimerQueue()
 	timerfdChannel_.remove();
 	::close(timerfd_);
 	// do not remove channel, since we're in EventLoop::dtor();
-	for (const Entry& timer : timers_)
-	{
-		delete timer.second;
-	}
+	// 定时器对象由chunks_释放
 }
 
 //增加一个定时器
 TimerId TimerQueue::addTimer(TimerCallback cb,//定时器回调函数
 	Timestamp when,//超时事件
-	double interval)//时间间隔
+	double interval,//时间间隔
+	double slack)
 {
-	//构造一个定时器对象
-	Timer* timer = new Timer(std::move(cb), when, interval);
-	//调用回调函数
+	//从内存池取一个定时器对象
+	Timer* timer = allocTimer();
+	timer->set(std::move(cb), when, interval, slack);
+	int64_t sequence = timer->sequence();
 	loop_->runInLoop(
 		std::bind(&TimerQueue::addTimerInLoop, this, timer));
-	return TimerId(timer, timer->sequence());
+	return TimerId(timer, sequence);
 }
 
 void TimerQueue::cancel(TimerId timerId)
@@ -144,41 +186,41 @@ void TimerQueue::addTimerInLoop(Timer* timer)
 {
 	//断言是否处于IO线程当中
 	loop_->assertInLoopThread();
-	//插入一个定时器，有可能会使得最早到期的定时器发生改变
-	//TimerQueue维护了一系列的定时器，那么这些定时器都有自己的到期时间
-	//我们新插入的定时器到期时间可能比原有的定时器到期时间早
-	//那么earliestChanged，就为true
-	bool earliestChanged = insert(timer);
-
-	if (earliestChanged)
+	if (timer->canceled())
+	{
+		// 加入之前就被取消了
+		freeTimer(timer);
+		return;
+	}
+	int64_t tick = tickFor(timer);
+	wheel_.add(timer, tick);
+	//新的定时器比timerfd设置的时间早，重置timerfd
+	if (armedTick_ < 0 || tick < armedTick_)
 	{
-		//重置定时器的超时时刻（timerfd_settime）
-		//我们能要把早先的定时器先触发
-		resetTimerfd(timerfd_/*定时器的fd*/, timer->expiration()/*到期事件*/);
+		arm(tick);
 	}
 }
 
-//取消循环
+//取消定时器
 void TimerQueue::cancelInLoop(TimerId timerId)
 {
 	loop_->assertInLoopThread();
-	assert(timers_.size() == activeTimers_.size());
-	ActiveTimer timer(timerId.timer_, timerId.sequence_);
-	//查找该定时器
-	ActiveTimerSet::iterator it = activeTimers_.find(timer);
-	if (it != activeTimers_.end())
+	Timer* timer = timerId.timer_;
+	//序号不同说明已经到期并被回收了
+	if (timer == NULL || timer->sequence() != timerId.sequence_)
+	{
+		return;
+	}
+	if (wheel_.contains(timer))
 	{
-		size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
-		assert(n == 1); (void)n;
-		delete it->first; // 如果使用unique_ptr，就不用手动删除了
-		activeTimers_.erase(it);//移除
+		wheel_.remove(timer);
+		freeTimer(timer);
 	}
-	else if (callingExpiredTimers_)//如果定时器不在列表当中，就是已经到期了
+	else
 	{
-		//已经到期了，并且正在调用回调函数的定时器
-		cancelingTimers_.insert(timer);
+		//正在调用回调函数，或者addTimerInLoop()还没有执行
+		timer->cancel();
 	}
-	assert(timers_.size() == activeTimers_.size());
 }
 
 
@@ -187,115 +229,155 @@ void TimerQueue::handleRead()
 	loop_->assertInLoopThread();
 	Timestamp now(Timestamp::now());
 	readTimerfd(timerfd_, now);//清除该事件，避免一直触发
+	handleExpired(now);
+}
+
+void TimerQueue::handleExpired(Timestamp now)
+{
+	armedTick_ = -1;
 
 	//获取该时刻之前所有的定时器列表（即超时定时器列表）
-	std::vector<Entry> expired = getExpired(now);
+	assert(expired_.empty());
+	wheel_.advance(now.microSecondsSinceEpoch() / kMicroSecondsPerTick, &expired_);
+	std::sort(expired_.begin(), expired_.end(), earlier);
 
 	callingExpiredTimers_ = true;
-	cancelingTimers_.clear();
 	// safe to callback outside critical section
-	for (const Entry& it : expired)
+	for (Timer* timer : expired_)
 	{
-		//调用定时器的回调函数
-		it.second->run();
+		//前面的回调函数可能取消了这个定时器
+		if (!timer->canceled())
+		{
+			//调用定时器的回调函数
+			timer->run();
+		}
 	}
 	callingExpiredTimers_ = false;
 
 	//如果不是一次性定时器，我们要重启
-	reset(expired, now);
+	reset(now);
 }
 
-
-//获取该时刻之前所有的定时器列表（即超时定时器列表）
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
+void TimerQueue::reset(Timestamp now)
 {
-	assert(timers_.size() == activeTimers_.size());
-	std::vector<Entry> expired;
-	Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
-	//返回第一个未到期的Timer的迭代器
-	//lower_bound的含义是返回第一个值 >= sentry的元素的iterator
-	//即*end >= sentry,从而end->fist > now
-	TimerList::iterator end = timers_.lower_bound(sentry);
-	assert(end == timers_.end() || now < end->first);
-	//将到期的定时器插入到 expired
-	std::copy(timers_.begin(), end, back_inserter(expired));
-	//从timers_中移除到期的定时器
-	timers_.erase(timers_.begin(), end);
-
-	//从activeTimers_中移除到期的定时器
-	for (const Entry& it : expired)
+	for (Timer* timer : expired_)
 	{
-		ActiveTimer timer(it.second, it.second->sequence());
-		size_t n = activeTimers_.erase(timer);
-		assert(n == 1); (void)n;
+		//如果是重复的定时器并且是未取消定时器，则重启该定时器
+		if (timer->repeat() && !timer->canceled())
+		{
+			timer->restart(now);
+			wheel_.add(timer, tickFor(timer));
+		}
+		else
+		{
+			//一次性定时器或者已被取消的定时器放回内存池
+			freeTimer(timer);
+		}
 	}
+	expired_.clear();
 
-	assert(timers_.size() == activeTimers_.size());
-	return expired;
+	arm(wheel_.nextTick());
 }
 
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
+void TimerQueue::arm(int64_t tick)
 {
-	Timestamp nextExpire;
-
-	for (const Entry& it : expired)
+	if (tick >= 0)
 	{
-		ActiveTimer timer(it.second, it.second->sequence());
-		//如果是重复的定时器并且是未取消定时器，则重启该定时器
-		if (it.second->repeat()
-			&& cancelingTimers_.find(timer) == cancelingTimers_.end())
-		{
-			it.second->restart(now);
-			insert(it.second);
-		}
-		else
+		numArms_.fetch_add(1, std::memory_order_relaxed);
+		if (useTimerfd_)
 		{
-			//一次性定时器不用重置或者已被取消的定时器是不能重置的，因此直接删除该定时器
-		  // FIXME move to a free list
-			delete it.second; // FIXME: no delete please
+			resetTimerfd(timerfd_, Timestamp(tick * kMicroSecondsPerTick));
 		}
 	}
+	armedTick_ = tick;
+}
 
-	if (!timers_.empty())
+int64_t TimerQueue::tickFor(const Timer* timer) const
+{
+	int64_t first = tickOf(timer->expiration());
+	if (timer->slack() <= 0.0)
 	{
-		nextExpire = timers_.begin()->second->expiration();
+		return first;
 	}
-
-	if (nextExpire.valid())
+	int64_t last = tickOf(addTime(timer->expiration(), timer->slack()));
+	// 已经设置的唤醒在窗口内，不用再设置timerfd
+	if (armedTick_ >= first && armedTick_ <= last)
 	{
-		resetTimerfd(timerfd_, nextExpire);
+		return armedTick_;
 	}
+	return roundTick(first, last);
 }
 
-bool TimerQueue::insert(Timer* timer)
+void TimerQueue::setUseTimerfd(bool on)
 {
-	//断言
 	loop_->assertInLoopThread();
-	assert(timers_.size() == activeTimers_.size());
-	//最早到期时间是否改变
-	bool earliestChanged = false;
-	Timestamp when = timer->expiration();//取出到期时间
-	TimerList::iterator it = timers_.begin();
-	if (it == timers_.end() || when < it->first)
+	if (on == useTimerfd_)
 	{
-		//timers是空的
-		//如果定时器的到期时间早于原有的定时器到期时间，把earliestChanged置为true
-		earliestChanged = true;
+		return;
 	}
+	useTimerfd_ = on;
+	if (on)
 	{
-		//插入到timers_
-		std::pair<TimerList::iterator, bool> result = timers_.insert(Entry(when, timer));
-		assert(result.second);
-		(void)result;
+		timerfdChannel_.enableReading();
+		if (armedTick_ >= 0)
+		{
+			resetTimerfd(timerfd_, Timestamp(armedTick_ * kMicroSecondsPerTick));
+		}
 	}
+	else
 	{
-		//插入到activeTimers_
-		std::pair<ActiveTimerSet::iterator, bool> result = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
-		assert(result.second);
-		(void)result;
+		timerfdChannel_.disableAll();
+		stopTimerfd(timerfd_);
 	}
+}
 
-	assert(timers_.size() == activeTimers_.size());
-	return earliestChanged;
+int TimerQueue::pollTimeout(Timestamp now, int maxMs) const
+{
+	if (armedTick_ < 0)
+	{
+		return maxMs;
+	}
+	int64_t microseconds = armedTick_ * kMicroSecondsPerTick - now.microSecondsSinceEpoch();
+	if (microseconds <= 0)
+	{
+		return 0;
+	}
+	// 向上取整，不会早醒
+	int64_t ms = (microseconds + 999) / 1000;
+	return static_cast<int>(std::min(ms, static_cast<int64_t>(maxMs)));
 }
 
+void TimerQueue::expire(Timestamp now)
+{
+	loop_->assertInLoopThread();
+	if (!useTimerfd_ && armedTick_ >= 0
+		&& now.microSecondsSinceEpoch() / kMicroSecondsPerTick >= armedTick_)
+	{
+		handleExpired(now);
+	}
+}
+
+Timer* TimerQueue::allocTimer()
+{
+	MutexLockGuard lock(mutex_);
+	if (freeTimers_.empty())
+	{
+		Timer* timers = new Timer[kTimersPerChunk];
+		chunks_.push_back(std::unique_ptr<Timer[]>(timers));
+		for (int i = kTimersPerChunk - 1; i >= 0; --i)
+		{
+			freeTimers_.push_back(&timers[i]);
+		}
+	}
+	Timer* timer = freeTimers_.back();
+	freeTimers_.pop_back();
+	return timer;
+}
+
+void TimerQueue::freeTimer(Timer* timer)
+{
+	// 在锁外析构回调函数
+	timer->clear();
+	MutexLockGuard lock(mutex_);
+	freeTimers_.push_back(timer);
+}
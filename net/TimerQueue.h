@@ -3,13 +3,15 @@
 #ifndef MUDUO_NET_TIMERQUEUE_H
 #define MUDUO_NET_TIMERQUEUE_H
 
-#include <set>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/TimingWheel.h"
 
 namespace muduo
 {
@@ -24,6 +26,15 @@ namespace muduo
 		/// A best efforts timer queue.
 		/// No guarantee that the callback will be on time.
 		///
+		/// Timers are kept in a TimingWheel of 1ms ticks, a callback runs
+		/// within a millisecond after its time. Timers expiring in the same
+		/// wakeup run in order of their time. Adding and canceling are O(1),
+		/// the Timer objects come from a pool and are reused.
+		///
+		/// A timer with slack may run late by up to its slack. It joins the
+		/// armed wakeup if that falls in its window, otherwise it takes the
+		/// roundest tick in the window, so timers with overlapping windows
+		/// share a wakeup and the timerfd is re-armed less often.
 		class TimerQueue : noncopyable
 		{
 		public:
@@ -41,25 +52,29 @@ namespace muduo
 			//添加定时器，返回TimerID对象
 			TimerId addTimer(TimerCallback cb,
 				Timestamp when,
-				double interval);
+				double interval,
+				double slack);
 			//cancel也可以跨线程调用
 			//取消定时器，需要指明定时器ID才能取消定时器
 			void cancel(TimerId timerId);
 
-		private:
+			/// Uses a timerfd (default) or the poll timeout of the loop, which
+			/// then calls pollTimeout() and expire(). Saves the timerfd_settime()
+			/// calls. Must be called in the loop thread.
+			void setUseTimerfd(bool on);
+			bool useTimerfd() const { return useTimerfd_; }
+
+			/// Milliseconds until the next wakeup, at most @c maxMs.
+			int pollTimeout(Timestamp now, int maxMs) const;
+			/// Runs the expired timers without the timerfd.
+			void expire(Timestamp now);
 
-			// FIXME: use unique_ptr<Timer> instead of raw pointers.
-			// This requires heterogeneous comparison lookup (N3465) from C++14
-			// so that we can find an T* in a set<unique_ptr<T>>.
-			   //unique_ptr是C++11标准的一个独享所有权的智能指针
-			   //但可以进行移动构造与移动赋值操作，即所有权可以移动到另一个对象（而非拷贝构造）
-			typedef std::pair<Timestamp, Timer*> Entry;
-			typedef std::set<Entry> TimerList;//TimerList以时间戳来进行排序
+			/// Times the wakeup was set, each is a timerfd_settime() with the timerfd.
+			/// Safe to read from other threads.
+			int64_t numArms() const { return numArms_.load(std::memory_order_relaxed); }
 
-			//ActiveTimerSet与TimerList是一样的，只不过其排序方式不一样
-			//ActiveTimerSet按时间戳地址排序
-			typedef std::pair<Timer*, int64_t> ActiveTimer;
-			typedef std::set<ActiveTimer> ActiveTimerSet;
+		private:
+			static const int kTimersPerChunk = 256;
 
 			//一下成员函数只可以在其所属的IO线程中调用。因而不需要加锁
 			//服务器性能杀手之一是锁竞争，所以要尽可能少用锁
@@ -67,24 +82,30 @@ namespace muduo
 			void cancelInLoop(TimerId timerId);
 			// called when timerfd alarms
 			void handleRead();//处理可读事件
-			// move out all expired timers
-			//返回超时的定时器列表，在该时刻可能有多个超时的定时器
-			std::vector<Entry> getExpired(Timestamp now);
+			void handleExpired(Timestamp now);
+			int64_t tickFor(const Timer* timer) const;
 			//对这些超时的定时器重置，因为这些定时器可能是可重复的定时器
-			void reset(const std::vector<Entry>& expired, Timestamp now);
+			void reset(Timestamp now);
+			void arm(int64_t tick);
 
-			bool insert(Timer* timer);
+			// 可以跨线程调用
+			Timer* allocTimer();
+			void freeTimer(Timer* timer);
 
 			EventLoop* loop_;//所属EventLoop
 			const int timerfd_;//timerfd_create所创建出来的定时器文件描述符
 			Channel timerfdChannel_;//定时器通道，当定时器事件到来的时候，可读事件产生，会回调handleRead函数
-			// Timer list sorted by expiration
-			TimerList timers_;//timers_是按到期时间排序的列表
-
-			// for cancel()
-			ActiveTimerSet activeTimers_;	//按照Timer地址排序的列表
+			TimingWheel wheel_;
+			int64_t armedTick_;		// timerfd设置的tick，-1表示没有设置
+			bool useTimerfd_;
+			std::atomic<int64_t> numArms_;	// 只在IO线程中增加，其他线程可以读
 			bool callingExpiredTimers_;		//atomic 是否处于调用超时的定时器当中
-			ActiveTimerSet cancelingTimers_;//保存的是被取消的定时器
+			std::vector<Timer*> expired_;	// 本次超时的定时器
+
+			// Timer对象只在析构时释放，过期的TimerId指向的对象总是有效的
+			MutexLock mutex_;
+			std::vector<std::unique_ptr<Timer[]> > chunks_ GUARDED_BY(mutex_);
+			std::vector<Timer*> freeTimers_ GUARDED_BY(mutex_);
 		};
 
 	}  // namespace net
@@ -0,0 +1,216 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include "muduo/net/TimingWheel.h"
+
+#include "muduo/base/Types.h"
+#include "muduo/net/Timer.h"
+
+#include <algorithm>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int TimingWheel::kLevels;
+const int TimingWheel::kRootBits;
+const int TimingWheel::kLevelBits;
+const int TimingWheel::kRootSlots;
+const int TimingWheel::kLevelSlots;
+
+TimingWheel::TimingWheel(int64_t tick)
+	: nextTick_(tick),
+	size_(0)
+{
+	memZero(counts_, sizeof counts_);
+	memZero(root_, sizeof root_);
+	memZero(levels_, sizeof levels_);
+}
+
+void TimingWheel::add(Timer* timer, int64_t tick)
+{
+	assert(!contains(timer));
+	timer->tick_ = tick;
+	int64_t delta = tick - nextTick_;
+	if (delta < 0)
+	{
+		// 已经过期，下一个tick处理
+		link(timer, 0, static_cast<int>(nextTick_ & (kRootSlots - 1)));
+		return;
+	}
+
+	// 能放下delta的最低一层
+	int level = 0;
+	while (level < kLevels - 1 && delta >= (static_cast<int64_t>(1) << shiftOf(level + 1)))
+	{
+		++level;
+	}
+	const int64_t kMaxDelta = (static_cast<int64_t>(1) << shiftOf(kLevels)) - 1;
+	if (delta > kMaxDelta)
+	{
+		// 超出时间轮的范围，先放在最远的位置，转到时再重新放
+		tick = nextTick_ + kMaxDelta;
+	}
+	const int mask = level == 0 ? kRootSlots - 1 : kLevelSlots - 1;
+	link(timer, level, static_cast<int>((tick >> shiftOf(level)) & mask));
+}
+
+void TimingWheel::remove(Timer* timer)
+{
+	assert(contains(timer));
+	if (timer->prev_)
+	{
+		timer->prev_->next_ = timer->next_;
+	}
+	else
+	{
+		head(timer->level_, timer->slot_) = timer->next_;
+	}
+	if (timer->next_)
+	{
+		timer->next_->prev_ = timer->prev_;
+	}
+	--counts_[timer->level_];
+	--size_;
+	timer->level_ = -1;
+	timer->prev_ = NULL;
+	timer->next_ = NULL;
+}
+
+bool TimingWheel::contains(const Timer* timer) const
+{
+	return timer->level_ >= 0;
+}
+
+void TimingWheel::advance(int64_t tick, std::vector<Timer*>* expired)
+{
+	while (nextTick_ <= tick)
+	{
+		if (size_ == 0)
+		{
+			nextTick_ = tick + 1;
+			break;
+		}
+		if (counts_[0] == 0)
+		{
+			// 下面几层都是空的，直接转到第一个非空层的下一格
+			int level = 1;
+			while (level < kLevels - 1 && counts_[level] == 0)
+			{
+				++level;
+			}
+			const int64_t span = static_cast<int64_t>(1) << shiftOf(level);
+			const int64_t next = (nextTick_ + span - 1) & ~(span - 1);
+			if (next > tick)
+			{
+				nextTick_ = tick + 1;
+				break;
+			}
+			nextTick_ = next;
+		}
+
+		const int slot = static_cast<int>(nextTick_ & (kRootSlots - 1));
+		if (slot == 0)
+		{
+			// 上一层转过一格，把这一格的定时器放到下面的层
+			for (int level = 1; level < kLevels; ++level)
+			{
+				int index = static_cast<int>((nextTick_ >> shiftOf(level)) & (kLevelSlots - 1));
+				cascade(level, index);
+				if (index != 0)
+				{
+					break;
+				}
+			}
+		}
+
+		Timer* timer = root_[slot];
+		root_[slot] = NULL;
+		while (timer)
+		{
+			Timer* next = timer->next_;
+			timer->level_ = -1;
+			timer->prev_ = NULL;
+			timer->next_ = NULL;
+			--counts_[0];
+			--size_;
+			expired->push_back(timer);
+			timer = next;
+		}
+		++nextTick_;
+	}
+}
+
+int64_t TimingWheel::nextTick() const
+{
+	if (size_ == 0)
+	{
+		return -1;
+	}
+	int64_t next = INT64_MAX;
+	if (counts_[0] > 0)
+	{
+		for (int64_t tick = nextTick_; tick < nextTick_ + kRootSlots; ++tick)
+		{
+			if (root_[tick & (kRootSlots - 1)])
+			{
+				next = tick;
+				break;
+			}
+		}
+	}
+	// 上面各层的定时器在转到它所在的格子时移到下一层
+	for (int level = 1; level < kLevels; ++level)
+	{
+		if (counts_[level] == 0)
+		{
+			continue;
+		}
+		const int shift = shiftOf(level);
+		for (int64_t block = nextTick_ >> shift; block <= (nextTick_ >> shift) + kLevelSlots; ++block)
+		{
+			const int64_t start = block << shift;
+			if (start >= nextTick_ && head(level, static_cast<int>(block & (kLevelSlots - 1))))
+			{
+				next = std::min(next, start);
+				break;
+			}
+		}
+	}
+	assert(next != INT64_MAX);
+	return next;
+}
+
+void TimingWheel::link(Timer* timer, int level, int slot)
+{
+	Timer*& first = head(level, slot);
+	timer->level_ = level;
+	timer->slot_ = slot;
+	timer->prev_ = NULL;
+	timer->next_ = first;
+	if (first)
+	{
+		first->prev_ = timer;
+	}
+	first = timer;
+	++counts_[level];
+	++size_;
+}
+
+void TimingWheel::cascade(int level, int slot)
+{
+	Timer* timer = head(level, slot);
+	head(level, slot) = NULL;
+	while (timer)
+	{
+		Timer* next = timer->next_;
+		timer->level_ = -1;
+		--counts_[level];
+		--size_;
+		add(timer, timer->tick_);
+		timer = next;
+	}
+}
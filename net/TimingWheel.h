@@ -0,0 +1,84 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_TIMINGWHEEL_H
+#define MUDUO_NET_TIMINGWHEEL_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace muduo
+{
+	namespace net
+	{
+
+		class Timer;
+
+		///
+		/// Hierarchical timing wheel of Timers, as in the Linux kernel before 4.8.
+		///
+		/// Time is counted in ticks. The root level has 256 slots of one tick,
+		/// each of the four upper levels has 64 slots of 64 times the level below,
+		/// 2^32 ticks in all. A timer goes into the slot of the lowest level which
+		/// reaches its tick, and moves down a level when the wheel turns to its
+		/// slot. Adding and removing are O(1), the timers are linked through
+		/// themselves so neither allocates. Runs of empty levels are skipped.
+		///
+		/// Not thread safe, TimerQueue uses it in the loop thread.
+		class TimingWheel : noncopyable
+		{
+		public:
+			/// Ticks before @c tick are taken as done.
+			explicit TimingWheel(int64_t tick);
+
+			/// Timers due in the past go into the next tick.
+			void add(Timer* timer, int64_t tick);
+			void remove(Timer* timer);
+			bool contains(const Timer* timer) const;
+
+			/// Appends the timers due at or before tick to expired, earlier ticks
+			/// first, and removes them.
+			void advance(int64_t tick, std::vector<Timer*>* expired);
+
+			/// The first tick at which advance() finds something to do, either an
+			/// expired timer or timers to move down a level. -1 if empty.
+			int64_t nextTick() const;
+
+			size_t size() const { return size_; }
+
+		private:
+			static const int kLevels = 5;
+			static const int kRootBits = 8;
+			static const int kLevelBits = 6;
+			static const int kRootSlots = 1 << kRootBits;
+			static const int kLevelSlots = 1 << kLevelBits;
+
+			static int shiftOf(int level) { return level == 0 ? 0 : kRootBits + (level - 1) * kLevelBits; }
+			Timer*& head(int level, int slot)
+			{
+				return level == 0 ? root_[slot] : levels_[level - 1][slot];
+			}
+			Timer* head(int level, int slot) const
+			{
+				return level == 0 ? root_[slot] : levels_[level - 1][slot];
+			}
+
+			void link(Timer* timer, int level, int slot);
+			void cascade(int level, int slot);
+
+			int64_t nextTick_;		// 下一个要处理的tick
+			size_t size_;
+			int counts_[kLevels];	// 每一层的定时器数，用来跳过空的层
+			Timer* root_[kRootSlots];
+			Timer* levels_[kLevels - 1][kLevelSlots];
+		};
+
+	}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TIMINGWHEEL_H
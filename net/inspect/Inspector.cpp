@@ -3,6 +3,7 @@
 #include "muduo/base/Logging.h"
 #include "muduo/base/Thread.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/net/MemoryBudget.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
 #include "muduo/net/inspect/ProcessInspector.h"
@@ -116,6 +117,14 @@ void Inspector::remove(const string& module, const string& command)
 		helps_[module].erase(command);
 	}
 }
+
+void Inspector::addMemoryBudget(const MemoryBudget* budget)
+{
+	add("net", "memory",
+		[budget](HttpRequest::Method, const ArgList&) { return budget->report(); },
+		"print buffer memory of all connections");
+}
+
 //启动http服务器
 void Inspector::start()
 {
@@ -14,6 +14,7 @@ namespace muduo
 	namespace net
 	{
 
+		class MemoryBudget;
 		class ProcessInspector;
 		class PerformanceInspector;
 		class SystemInspector;
@@ -41,6 +42,10 @@ namespace muduo
 				const string& help);
 			void remove(const string& module, const string& command);
 
+			/// Reports the connection buffer memory of budget at /net/memory.
+			/// budget must outlive the inspector.
+			void addMemoryBudget(const MemoryBudget* budget);
+
 		private:
 			typedef std::map<string, Callback> CommandList;	// 命令列表，<命令名称, 命令处理函数>
 			typedef std::map<string, string> HelpList;	// 帮助列表，<命令名称, 帮助信息>
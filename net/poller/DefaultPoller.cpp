@@ -1,6 +1,8 @@
 ﻿#include "muduo/net/Poller.h"
 #include "muduo/net/poller/PollPoller.h"
 #include "muduo/net/poller/EPollPoller.h"
+#include "muduo/net/poller/UringPoller.h"
+#include "muduo/base/Logging.h"
 
 #include <stdlib.h>
 
@@ -13,6 +15,15 @@ Poller* Poller::newDefaultPoller(EventLoop* loop)
   {
     return new PollPoller(loop);
   }
+  else if (::getenv("MUDUO_USE_URING"))
+  {
+    if (UringPoller::isSupported())
+    {
+      return new UringPoller(loop);
+    }
+    LOG_WARN << "io_uring is not supported, falling back to epoll";
+    return new EPollPoller(loop);
+  }
   else
   {
     return new EPollPoller(loop);
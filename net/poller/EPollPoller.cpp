@@ -29,11 +29,18 @@ static_assert(EPOLLRDHUP == POLLRDHUP, "epoll uses same flag values as poll");
 static_assert(EPOLLERR == POLLERR, "epoll uses same flag values as poll");
 static_assert(EPOLLHUP == POLLHUP, "epoll uses same flag values as poll");
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)	// Linux 4.5
+#endif
+
 namespace
 {
 	const int kNew = -1;
 	const int kAdded = 1;
 	const int kDeleted = 2;
+
+	// 边沿触发的通道一直注册读写，关注的事件变化时不调用epoll_ctl
+	const int kEdgeTriggeredEvents = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLET;
 }
 
 EPollPoller::EPollPoller(EventLoop* loop)
@@ -106,7 +113,17 @@ void EPollPoller::fillActiveChannels(int numEvents,
 		assert(it != channels_.end());
 		assert(it->second == channel);
 #endif
-		channel->set_revents(events_[i].events);
+		int revents = events_[i].events;
+		if (channel->edgeTriggered())
+		{
+			// 丢掉不关注的边沿，重新关注读的时候updateChannel()会补上
+			revents &= channel->events() | EPOLLERR | EPOLLHUP;
+			if (revents == 0)
+			{
+				continue;
+			}
+		}
+		channel->set_revents(revents);
 		//把有事件的通道加入 活跃通道队列中
 		activeChannels->push_back(channel);
 	}
@@ -138,6 +155,14 @@ void EPollPoller::updateChannel(Channel* channel)
 			assert(channels_[fd] == channel);
 		}
 
+		if (channel->edgeTriggered())
+		{
+			if (static_cast<size_t>(fd) >= edgeInterests_.size())
+			{
+				edgeInterests_.resize(fd + 1);
+			}
+			edgeInterests_[fd] = channel->events();
+		}
 		//设置channel的状态，为kAdded表示该通道为已添加的状态
 		channel->set_index(kAdded);
 		//在把通道添加到Epoll中
@@ -156,6 +181,16 @@ void EPollPoller::updateChannel(Channel* channel)
 			update(EPOLL_CTL_DEL, channel);
 			channel->set_index(kDeleted);
 		}
+		else if (channel->edgeTriggered())
+		{
+			// 停止读期间到来的数据不会再有边沿，EPOLL_CTL_MOD让内核重新检查一次
+			const int gained = channel->events() & ~edgeInterests_[fd];
+			edgeInterests_[fd] = channel->events();
+			if (gained & (EPOLLIN | EPOLLPRI))
+			{
+				update(EPOLL_CTL_MOD, channel);
+			}
+		}
 		else
 		{
 			update(EPOLL_CTL_MOD, channel);
@@ -193,7 +228,12 @@ void EPollPoller::update(int operation, Channel* channel)
 {
 	struct epoll_event event;
 	memZero(&event, sizeof event);//初始化event结构体
-	event.events = channel->events();
+	event.events = channel->edgeTriggered() ? kEdgeTriggeredEvents : channel->events();
+	// EPOLLEXCLUSIVE只能用于EPOLL_CTL_ADD，也不能和EPOLLPRI一起用
+	if (channel->exclusive() && operation == EPOLL_CTL_ADD && !channel->isNoneEvent())
+	{
+		event.events = (event.events & ~EPOLLPRI) | EPOLLEXCLUSIVE;
+	}
 	event.data.ptr = channel;//event中的数据指针指向事件通道
 	int fd = channel->fd();
 	LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
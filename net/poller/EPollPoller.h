@@ -40,6 +40,8 @@ class EPollPoller : public Poller
 
   int epollfd_;
   EventList events_;
+  // interest of edge triggered channels, indexed by fd
+  std::vector<int> edgeInterests_;
 };
 
 }  // namespace net
@@ -151,5 +151,7 @@ void PollPoller::removeChannel(Channel* channel)
     channels_[channelAtEnd]->set_index(idx);
     pollfds_.pop_back();
   }
+  // 可以再加入另一个poller，见TcpConnection::moveToLoop()
+  channel->set_index(-1);
 }
 
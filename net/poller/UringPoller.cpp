@@ -0,0 +1,364 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include "muduo/net/poller/UringPoller.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const unsigned UringPoller::kSqEntries;
+const unsigned UringPoller::kCqEntries;
+
+namespace
+{
+	const int kNew = -1;
+	const int kAdded = 1;
+
+	// POLL_REMOVE的完成事件，忽略
+	const uint64_t kCancelUserData = ~static_cast<uint64_t>(0);
+
+	uint64_t makeUserData(int fd, uint32_t generation)
+	{
+		return static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(fd);
+	}
+
+	int uringSetup(unsigned entries, struct io_uring_params* params)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	unsigned* ringField(void* ring, uint32_t offset)
+	{
+		return reinterpret_cast<unsigned*>(static_cast<char*>(ring) + offset);
+	}
+
+	void* mapRing(int fd, size_t size, off_t offset)
+	{
+		void* ptr = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, offset);
+		if (ptr == MAP_FAILED)
+		{
+			LOG_SYSFATAL << "UringPoller mmap";
+		}
+		return ptr;
+	}
+}
+
+bool UringPoller::isSupported()
+{
+	struct io_uring_params params;
+	memZero(&params, sizeof params);
+	int fd = uringSetup(1, &params);
+	if (fd < 0)
+	{
+		return false;
+	}
+	::close(fd);
+	// 需要带超时的等待，以及CQ满时不丢弃完成事件
+	const uint32_t required = IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+	return (params.features & required) == required;
+}
+
+UringPoller::UringPoller(EventLoop* loop)
+	: Poller(loop),
+	ringFd_(-1),
+	sqRing_(NULL),
+	cqRing_(NULL),
+	sqRingSize_(0),
+	cqRingSize_(0),
+	sqes_(NULL),
+	sqesSize_(0),
+	sqTailLocal_(0),
+	toSubmit_(0)
+{
+	struct io_uring_params params;
+	memZero(&params, sizeof params);
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = kCqEntries;
+	ringFd_ = uringSetup(kSqEntries, &params);
+	if (ringFd_ < 0)
+	{
+		LOG_SYSFATAL << "UringPoller::UringPoller";
+	}
+
+	sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		// SQ和CQ共用一次映射
+		sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+		sqRing_ = mapRing(ringFd_, sqRingSize_, IORING_OFF_SQ_RING);
+		cqRing_ = sqRing_;
+		cqRingSize_ = 0;
+	}
+	else
+	{
+		sqRing_ = mapRing(ringFd_, sqRingSize_, IORING_OFF_SQ_RING);
+		cqRing_ = mapRing(ringFd_, cqRingSize_, IORING_OFF_CQ_RING);
+	}
+	sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqes_ = static_cast<struct io_uring_sqe*>(mapRing(ringFd_, sqesSize_, IORING_OFF_SQES));
+
+	sqHead_ = ringField(sqRing_, params.sq_off.head);
+	sqTail_ = ringField(sqRing_, params.sq_off.tail);
+	sqFlags_ = ringField(sqRing_, params.sq_off.flags);
+	sqArray_ = ringField(sqRing_, params.sq_off.array);
+	sqMask_ = *ringField(sqRing_, params.sq_off.ring_mask);
+	sqEntries_ = params.sq_entries;
+	sqTailLocal_ = *sqTail_;
+
+	cqHead_ = ringField(cqRing_, params.cq_off.head);
+	cqTail_ = ringField(cqRing_, params.cq_off.tail);
+	cqMask_ = *ringField(cqRing_, params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<struct io_uring_cqe*>(
+		static_cast<char*>(cqRing_) + params.cq_off.cqes);
+}
+
+UringPoller::~UringPoller()
+{
+	::munmap(sqes_, sqesSize_);
+	if (cqRing_ != sqRing_)
+	{
+		::munmap(cqRing_, cqRingSize_);
+	}
+	::munmap(sqRing_, sqRingSize_);
+	::close(ringFd_);
+}
+
+Timestamp UringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+	LOG_TRACE << "fd total count " << channels_.size();
+	armDirtyChannels();
+
+	// 已经有完成事件时不等待，只提交
+	const bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+	const bool overflow = __atomic_load_n(sqFlags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW;
+	int ret = 0;
+	if (!ready && timeoutMs != 0)
+	{
+		ret = enter(1, timeoutMs);
+	}
+	else if (toSubmit_ > 0 || overflow)
+	{
+		ret = enter(0, 0);
+	}
+	int savedErrno = errno;
+	Timestamp now(Timestamp::now());
+
+	int numEvents = fillActiveChannels(activeChannels);
+	if (numEvents > 0)
+	{
+		LOG_TRACE << numEvents << " events happened";
+	}
+	else if (ret >= 0 || savedErrno == ETIME)
+	{
+		LOG_TRACE << "nothing happened";
+	}
+	else if (savedErrno != EINTR)
+	{
+		errno = savedErrno;
+		LOG_SYSERR << "UringPoller::poll()";
+	}
+	return now;
+}
+
+void UringPoller::updateChannel(Channel* channel)
+{
+	Poller::assertInLoopThread();
+	const int index = channel->index();
+	const int fd = channel->fd();
+	LOG_TRACE << "fd = " << fd
+		<< " events = " << channel->events() << " index = " << index;
+	if (index == kNew)
+	{
+		assert(channels_.find(fd) == channels_.end());
+		channels_[fd] = channel;
+		channel->set_index(kAdded);
+	}
+	else
+	{
+		assert(channels_.find(fd) != channels_.end());
+		assert(channels_[fd] == channel);
+		assert(index == kAdded);
+	}
+
+	Entry& entry = entryOf(fd);
+	if (entry.armed && entry.events != channel->events())
+	{
+		cancel(fd, &entry);
+	}
+	// 没有在等待的poll，下次poll()前重新提交
+	if (!entry.armed)
+	{
+		markDirty(fd);
+	}
+}
+
+void UringPoller::removeChannel(Channel* channel)
+{
+	Poller::assertInLoopThread();
+	int fd = channel->fd();
+	LOG_TRACE << "fd = " << fd;
+	assert(channels_.find(fd) != channels_.end());
+	assert(channels_[fd] == channel);
+	assert(channel->isNoneEvent());
+	assert(channel->index() == kAdded);
+	size_t n = channels_.erase(fd);
+	(void)n;
+	assert(n == 1);
+
+	Entry& entry = entryOf(fd);
+	if (entry.armed)
+	{
+		cancel(fd, &entry);
+	}
+	channel->set_index(kNew);
+}
+
+UringPoller::Entry& UringPoller::entryOf(int fd)
+{
+	assert(fd >= 0);
+	if (static_cast<size_t>(fd) >= entries_.size())
+	{
+		entries_.resize(fd + 1);
+	}
+	return entries_[fd];
+}
+
+void UringPoller::markDirty(int fd)
+{
+	Entry& entry = entryOf(fd);
+	if (!entry.dirty)
+	{
+		entry.dirty = true;
+		dirtyFds_.push_back(fd);
+	}
+}
+
+void UringPoller::armDirtyChannels()
+{
+	for (int fd : dirtyFds_)
+	{
+		Entry& entry = entries_[fd];
+		entry.dirty = false;
+		ChannelMap::const_iterator it = channels_.find(fd);
+		if (entry.armed || it == channels_.end() || it->second->isNoneEvent())
+		{
+			continue;
+		}
+		// one-shot poll在提交时检查当前状态，效果等同于水平触发
+		struct io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fd;
+		sqe->poll32_events = it->second->events();
+		sqe->user_data = makeUserData(fd, entry.generation);
+		entry.events = it->second->events();
+		entry.armed = true;
+	}
+	dirtyFds_.clear();
+}
+
+void UringPoller::cancel(int fd, Entry* entry)
+{
+	LOG_TRACE << "poll remove fd = " << fd;
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = makeUserData(fd, entry->generation);
+	sqe->user_data = kCancelUserData;
+	// 被取消的poll的完成事件带着旧的generation，会被忽略
+	++entry->generation;
+	entry->armed = false;
+}
+
+struct io_uring_sqe* UringPoller::getSqe()
+{
+	if (sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_)
+	{
+		// SQ满了，先提交
+		if (enter(0, 0) < 0)
+		{
+			LOG_SYSFATAL << "UringPoller::getSqe()";
+		}
+	}
+	unsigned index = sqTailLocal_ & sqMask_;
+	struct io_uring_sqe* sqe = &sqes_[index];
+	memZero(sqe, sizeof *sqe);
+	sqArray_[index] = index;
+	++sqTailLocal_;
+	++toSubmit_;
+	return sqe;
+}
+
+int UringPoller::enter(unsigned minComplete, int timeoutMs)
+{
+	__atomic_store_n(sqTail_, sqTailLocal_, __ATOMIC_RELEASE);
+	unsigned flags = IORING_ENTER_GETEVENTS;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	memZero(&arg, sizeof arg);
+	if (minComplete > 0)
+	{
+		flags |= IORING_ENTER_EXT_ARG;
+		if (timeoutMs >= 0)
+		{
+			ts.tv_sec = timeoutMs / 1000;
+			ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+			arg.ts = reinterpret_cast<uint64_t>(&ts);
+		}
+	}
+	int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit_, minComplete,
+		flags, minComplete > 0 ? &arg : NULL, minComplete > 0 ? sizeof arg : 0));
+	if (ret >= 0)
+	{
+		assert(static_cast<unsigned>(ret) <= toSubmit_);
+		toSubmit_ -= ret;
+	}
+	return ret;
+}
+
+int UringPoller::fillActiveChannels(ChannelList* activeChannels)
+{
+	int numEvents = 0;
+	unsigned head = *cqHead_;
+	const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+	{
+		const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+		if (cqe.user_data == kCancelUserData)
+		{
+			continue;
+		}
+		const int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+		const uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+		Entry& entry = entries_[fd];
+		if (!entry.armed || entry.generation != generation)
+		{
+			continue;
+		}
+		entry.armed = false;
+		ChannelMap::const_iterator it = channels_.find(fd);
+		assert(it != channels_.end());
+		Channel* channel = it->second;
+		channel->set_revents(cqe.res >= 0 ? cqe.res : POLLERR);
+		activeChannels->push_back(channel);
+		markDirty(fd);
+		++numEvents;
+	}
+	__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+	return numEvents;
+}
@@ -0,0 +1,89 @@
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_POLLER_URINGPOLLER_H
+#define MUDUO_NET_POLLER_URINGPOLLER_H
+
+#include "muduo/net/Poller.h"
+
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// IO Multiplexing with io_uring(7) poll requests, readiness only.
+///
+/// Each channel has one one-shot IORING_OP_POLL_ADD in flight. Completed
+/// polls are re-armed, and interest changes are applied, in the same
+/// io_uring_enter(2) which waits for the next events, so a busy loop makes
+/// one syscall per iteration whatever the number of active channels.
+/// Needs Linux 5.11 (IORING_FEAT_EXT_ARG), see isSupported().
+///
+class UringPoller : public Poller
+{
+ public:
+  UringPoller(EventLoop* loop);
+  ~UringPoller() override;
+
+  Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+  void updateChannel(Channel* channel) override;
+  void removeChannel(Channel* channel) override;
+
+  /// Whether the kernel lets us create a ring with the features we need.
+  static bool isSupported();
+
+ private:
+  static const unsigned kSqEntries = 256;
+  static const unsigned kCqEntries = 4096;
+
+  struct Entry
+  {
+    Entry() : generation(0), events(0), armed(false), dirty(false) { }
+    uint32_t generation;  // user_data of stale completions doesn't match
+    int events;           // events of the poll in flight
+    bool armed;
+    bool dirty;           // in dirtyFds_, arm before the next wait
+  };
+
+  Entry& entryOf(int fd);
+  void markDirty(int fd);
+  void armDirtyChannels();
+  void cancel(int fd, Entry* entry);
+  struct io_uring_sqe* getSqe();
+  int enter(unsigned minComplete, int timeoutMs);
+  int fillActiveChannels(ChannelList* activeChannels);
+
+  int ringFd_;
+  void* sqRing_;
+  void* cqRing_;
+  size_t sqRingSize_;
+  size_t cqRingSize_;
+  struct io_uring_sqe* sqes_;
+  size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned* sqFlags_;
+  unsigned* sqArray_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned sqTailLocal_;  // 已填写但还没有提交给内核的位置
+  unsigned toSubmit_;
+
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  struct io_uring_cqe* cqes_;
+
+  std::vector<Entry> entries_;  // indexed by fd
+  std::vector<int> dirtyFds_;
+};
+
+}  // namespace net
+}  // namespace muduo
+#endif  // MUDUO_NET_POLLER_URINGPOLLER_H
@@ -0,0 +1,125 @@
+// Many clients connect at once, as after a restart of the server: the loop
+// which accepts is held up until they have all called connect(). Counts the
+// iterations of that loop until they are all established, with an accept
+// budget of 1 and of 64, the batches must take far fewer.
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2026;
+const int kClients = 3000;
+
+AtomicInt32 g_connected;
+AtomicInt32 g_disconnected;
+EventLoop* g_loop;
+int64_t g_start;
+int64_t g_end;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    if (g_connected.incrementAndGet() == kClients)
+    {
+      g_loop->queueInLoop([] { g_end = g_loop->iteration(); });
+    }
+  }
+  else if (g_disconnected.incrementAndGet() == kClients)
+  {
+    g_loop->queueInLoop(std::bind(&EventLoop::quit, g_loop));
+  }
+}
+
+void connectAll(CountDownLatch* connecting)
+{
+  std::vector<int> fds;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < kClients; ++i)
+  {
+    // 非阻塞connect，不等服务器accept
+    int fd = sockets::createNonblockingOrDie(AF_INET);
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+    if (ret < 0 && errno != EINPROGRESS)
+    {
+      LOG_SYSERR << "connect";
+    }
+    fds.push_back(fd);
+  }
+  connecting->countDown();
+  while (g_connected.get() < kClients)
+  {
+    usleep(10 * 1000);
+  }
+  for (int fd : fds)
+  {
+    ::close(fd);
+  }
+}
+
+int64_t run(TcpServer::AcceptMode mode, int budget)
+{
+  g_connected.getAndSet(0);
+  g_disconnected.getAndSet(0);
+  EventLoop loop;
+  g_loop = &loop;
+  TcpServer server(&loop, InetAddress(kPort), "AcceptBatch", TcpServer::kReusePort);
+  server.setThreadNum(3);
+  server.setAcceptMode(mode);
+  server.setAcceptBudget(budget);
+  server.setConnectionCallback(onConnection);
+  server.start();
+
+  CountDownLatch connecting(1);
+  Thread clients(std::bind(connectAll, &connecting));
+  loop.runAfter(0.2, [&] {
+    // 连接都在backlog中等着
+    clients.start();
+    connecting.wait();
+    g_start = loop.iteration();
+  });
+  loop.runAfter(30.0, [&loop] {
+    LOG_ERROR << "timeout";
+    loop.quit();
+  });
+  loop.loop();
+  clients.join();
+  int64_t iterations = g_end - g_start;
+  printf("mode %d, budget %d: %d connected, %d disconnected, %lld iterations\n",
+         mode, budget, g_connected.get(), g_disconnected.get(),
+         static_cast<long long>(iterations));
+  return iterations;
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  int64_t single = run(TcpServer::kSingleAcceptor, 1);
+  bool ok = g_disconnected.get() == kClients;
+  int64_t batched = run(TcpServer::kSingleAcceptor, 64);
+  ok = ok && g_disconnected.get() == kClients && batched * 4 < single;
+  run(TcpServer::kExclusivePerLoop, 64);
+  ok = ok && g_disconnected.get() == kClients;
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
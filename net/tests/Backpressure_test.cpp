@@ -0,0 +1,162 @@
+// A relay between loops with built-in backpressure.
+// The client floods the relay, whose inbound connection lives in an IO thread.
+// The relay forwards to a backend from the main loop, and the backend doesn't
+// read for the first second. The relay's output buffer must stay bounded.
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kTotal = 64 * 1024 * 1024;
+const size_t kHighMark = 1024 * 1024;
+const size_t kLowMark = 256 * 1024;
+
+char byteAt(size_t offset)
+{
+  return static_cast<char>(offset % 251);
+}
+
+int main()
+{
+  EventLoop loop;
+
+  // backend, doesn't read at first
+  EventLoopThread backendThread;
+  EventLoop* backendLoop = backendThread.startLoop();
+  InetAddress backendAddr(2021);
+  std::unique_ptr<TcpServer> backend(new TcpServer(backendLoop, backendAddr, "Backend"));
+  size_t received = 0;
+  bool ok = true;
+  backend->setConnectionCallback(
+      [backendLoop](const TcpConnectionPtr& conn)
+      {
+        if (conn->connected())
+        {
+          conn->stopRead();
+          backendLoop->runAfter(1.0, [conn] { conn->startRead(); });
+        }
+      });
+  backend->setMessageCallback(
+      [&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+      {
+        const char* data = buf->peek();
+        for (size_t i = 0; i < buf->readableBytes(); ++i)
+        {
+          if (data[i] != byteAt(received + i))
+          {
+            ok = false;
+          }
+        }
+        received += buf->readableBytes();
+        buf->retrieveAll();
+        if (received == kTotal)
+        {
+          conn->forceClose();
+        }
+      });
+  CountDownLatch started(1);
+  backendLoop->runInLoop([&] { backend->start(); started.countDown(); });
+  started.wait();
+
+  // client, floods the relay as fast as it can
+  TcpClient client(&loop, InetAddress("127.0.0.1", 2022), "Client");
+  size_t sent = 0;
+  auto sendMore = [&](const TcpConnectionPtr& conn)
+      {
+        if (sent < kTotal)
+        {
+          string chunk(std::min<size_t>(256 * 1024, kTotal - sent), '\0');
+          for (size_t i = 0; i < chunk.size(); ++i)
+          {
+            chunk[i] = byteAt(sent + i);
+          }
+          sent += chunk.size();
+          conn->send(std::move(chunk));
+        }
+      };
+  client.setConnectionCallback(
+      [&](const TcpConnectionPtr& conn)
+      {
+        if (conn->connected())
+        {
+          sendMore(conn);
+        }
+      });
+  client.setWriteCompleteCallback(sendMore);
+
+  // relay, inbound connections in an IO thread, outbound in this loop
+  InetAddress relayAddr(2022);
+  TcpServer relay(&loop, relayAddr, "Relay");
+  relay.setThreadNum(1);
+  TcpClient outbound(&loop, InetAddress("127.0.0.1", 2021), "Outbound");
+  TcpConnectionPtr backendConn;
+  size_t peakOutput = 0;
+  relay.setConnectionCallback(
+      [&](const TcpConnectionPtr& inbound)
+      {
+        if (inbound->connected())
+        {
+          // the output to the backend throttles the inbound side
+          loop.runInLoop(
+              [&backendConn, inbound]
+              {
+                backendConn->setBackpressure(kHighMark, kLowMark, inbound);
+              });
+        }
+      });
+  relay.setMessageCallback(
+      [&](const TcpConnectionPtr&, Buffer* buf, Timestamp)
+      {
+        // runs in the IO thread, send() moves the data to the main loop
+        backendConn->send(buf->retrieveAllAsString());
+      });
+  outbound.setConnectionCallback(
+      [&](const TcpConnectionPtr& conn)
+      {
+        if (conn->connected())
+        {
+          backendConn = conn;
+          relay.start();
+          client.connect();
+        }
+        else
+        {
+          // close the client side too, then quit
+          backendConn.reset();
+          client.disconnect();
+          loop.runAfter(0.5, std::bind(&EventLoop::quit, &loop));
+        }
+      });
+  loop.runEvery(0.01,
+      [&]
+      {
+        if (backendConn)
+        {
+          peakOutput = std::max(peakOutput, backendConn->outputBuffer()->readableBytes());
+        }
+      });
+  outbound.connect();
+  loop.loop();
+
+  // the backend must be destroyed in its own loop
+  CountDownLatch destroyed(1);
+  backendLoop->runInLoop([&] { backend.reset(); destroyed.countDown(); });
+  destroyed.wait();
+
+  // without backpressure nearly all of kTotal piles up in the relay,
+  // with it only what was already queued to this loop when the inbound side stopped
+  ok = ok && received == kTotal && peakOutput < 16 * kHighMark;
+  printf("received %zu of %zu bytes, peak relay output %zu bytes, %s\n",
+         received, kTotal, peakOutput, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
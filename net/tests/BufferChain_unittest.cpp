@@ -0,0 +1,214 @@
+#include "muduo/net/BufferChain.h"
+
+//#define BOOST_TEST_MODULE BufferChainTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <memory>
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::BufferChain;
+
+string drain(BufferChain* chain)
+{
+  string result;
+  struct iovec vec[BufferChain::kMaxIovecs];
+  int n = chain->peekIovec(vec, BufferChain::kMaxIovecs);
+  for (int i = 0; i < n; ++i)
+  {
+    result.append(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len);
+  }
+  chain->retrieve(result.size());
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainAppendRetrieve)
+{
+  BufferChain chain;
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 0);
+  BOOST_CHECK(chain.empty());
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+
+  chain.append(string(200, 'x'));
+  chain.append(string(300, 'y'));
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 500);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+
+  chain.retrieve(250);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 250);
+  BOOST_CHECK_EQUAL(drain(&chain), string(250, 'y'));
+  BOOST_CHECK(chain.empty());
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainNoMove)
+{
+  BufferChain chain;
+  chain.append(string(1000, 'a'));
+  struct iovec first;
+  BOOST_CHECK_EQUAL(chain.peekIovec(&first, 1), 1);
+
+  // the first chunk is full, the data goes to a new chunk instead of growing it
+  chain.append(string(100000, 'b'));
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+  struct iovec vec[2];
+  BOOST_CHECK_EQUAL(chain.peekIovec(vec, 2), 2);
+  BOOST_CHECK_EQUAL(vec[0].iov_base, first.iov_base);
+  BOOST_CHECK_EQUAL(vec[0].iov_len, 1000);
+  BOOST_CHECK_EQUAL(vec[1].iov_len, 100000);
+
+  chain.append(string(10, 'c'));
+  BOOST_CHECK_EQUAL(chain.numChunks(), 3);
+
+  chain.retrieve(1000 + 99990);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+  BOOST_CHECK_EQUAL(drain(&chain), string(10, 'b') + string(10, 'c'));
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainSwapBuffer)
+{
+  BufferChain chain;
+  chain.append("header", 6);
+
+  Buffer body;
+  body.append(string(5000, 'z'));
+  const char* inner = body.peek();
+  chain.append(&body);
+  BOOST_CHECK_EQUAL(body.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 5006);
+
+  struct iovec vec[2];
+  BOOST_CHECK_EQUAL(chain.peekIovec(vec, 2), 2);
+  BOOST_CHECK_EQUAL(vec[1].iov_base, inner);
+  BOOST_CHECK_EQUAL(drain(&chain), "header" + string(5000, 'z'));
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainWriteFd)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::pipe(fds), 0);
+
+  BufferChain chain;
+  chain.append(string(1000, 'a'));
+  chain.append(string(2000, 'b'));
+  chain.append(string(3000, 'c'));
+  int savedErrno = 0;
+  ssize_t n = chain.writeFd(fds[1], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 6000);
+  BOOST_CHECK(chain.empty());
+
+  char buf[6000];
+  BOOST_CHECK_EQUAL(::read(fds[0], buf, sizeof buf), 6000);
+  BOOST_CHECK_EQUAL(string(buf, 6000), string(1000, 'a') + string(2000, 'b') + string(3000, 'c'));
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainPayload)
+{
+  using muduo::net::Payload;
+  Payload frame(string(8000, 'p'));
+  BOOST_CHECK_EQUAL(frame.useCount(), 1);
+
+  BufferChain a;
+  BufferChain b;
+  a.append("hdr", 3);
+  a.append(frame);
+  b.append(frame);
+  // both chains refer to the same bytes
+  BOOST_CHECK_EQUAL(frame.useCount(), 3);
+  BOOST_CHECK_EQUAL(a.numChunks(), 2);
+  BOOST_CHECK_EQUAL(b.numChunks(), 1);
+  struct iovec vec[2];
+  BOOST_CHECK_EQUAL(a.peekIovec(vec, 2), 2);
+  BOOST_CHECK_EQUAL(vec[1].iov_base, frame.data());
+  BOOST_CHECK_EQUAL(b.peekIovec(vec, 1), 1);
+  BOOST_CHECK_EQUAL(vec[0].iov_base, frame.data());
+
+  a.retrieve(1003);
+  BOOST_CHECK_EQUAL(a.numChunks(), 1);
+  a.append("tail", 4);
+  BOOST_CHECK_EQUAL(a.numChunks(), 2);
+  BOOST_CHECK_EQUAL(drain(&a), string(7000, 'p') + "tail");
+  b.retrieveAll();
+  BOOST_CHECK_EQUAL(frame.useCount(), 1);
+
+  // small payloads are copied
+  Payload small(muduo::StringPiece("tiny"));
+  b.append(small);
+  BOOST_CHECK_EQUAL(small.useCount(), 1);
+  BOOST_CHECK_EQUAL(drain(&b), "tiny");
+
+  // an owned block and a moved string are taken without copying
+  std::unique_ptr<char[]> block(new char[5000]);
+  std::fill(block.get(), block.get() + 5000, 'q');
+  const char* blockData = block.get();
+  Payload owned(std::move(block), 5000);
+  BOOST_CHECK_EQUAL(owned.data(), blockData);
+  string moved(3000, 'm');
+  const char* movedData = moved.data();
+  Payload fromString(std::move(moved));
+  BOOST_CHECK_EQUAL(fromString.data(), movedData);
+  b.append(owned.slice(1000, 4000));
+  b.append(fromString);
+  BOOST_CHECK_EQUAL(owned.useCount(), 2);
+  BOOST_CHECK_EQUAL(drain(&b), string(4000, 'q') + string(3000, 'm'));
+  BOOST_CHECK_EQUAL(owned.useCount(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainFile)
+{
+  using muduo::net::FileRegion;
+  using muduo::net::FileRegionPtr;
+  char path[] = "/tmp/bufferchain_unittest_XXXXXX";
+  int filefd = ::mkstemp(path);
+  BOOST_REQUIRE(filefd >= 0);
+  ::unlink(path);
+  const string content(200000, 'f');
+  BOOST_REQUIRE_EQUAL(::write(filefd, content.data(), content.size()), 200000);
+
+  int sv[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+  BufferChain chain;
+  chain.append("before", 6);
+  FileRegionPtr file(new FileRegion(filefd, 1000, 3000));
+  ::close(filefd);  // the region owns a dup()
+  BOOST_REQUIRE(file->valid());
+  chain.append(file);
+  file.reset();
+  chain.append("after", 5);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 6 + 3000 + 5);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 3);
+
+  // iovecs stop at the file region
+  struct iovec vec[3];
+  BOOST_CHECK_EQUAL(chain.peekIovec(vec, 3), 1);
+
+  int savedErrno = 0;
+  string received;
+  char buf[4096];
+  while (!chain.empty())
+  {
+    BOOST_REQUIRE(chain.writeFd(sv[0], &savedErrno) > 0);
+    ssize_t n = ::read(sv[1], buf, sizeof buf);
+    BOOST_REQUIRE(n > 0);
+    received.append(buf, n);
+  }
+  ssize_t n = 0;
+  while (received.size() < 6 + 3000 + 5 && (n = ::read(sv[1], buf, sizeof buf)) > 0)
+  {
+    received.append(buf, n);
+  }
+  BOOST_CHECK_EQUAL(received, "before" + string(3000, 'f') + "after");
+  ::close(sv[0]);
+  ::close(sv[1]);
+}
@@ -0,0 +1,125 @@
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/BufferChain.h"
+
+//#define BOOST_TEST_MODULE BufferPoolTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::BufferChain;
+using muduo::net::BufferPool;
+
+BOOST_AUTO_TEST_CASE(testEmptyBuffer)
+{
+  Buffer buf(BufferPool::emptyBuffer());
+  BOOST_CHECK(!BufferPool::hasStorage(buf));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.writableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.internalCapacity(), 0);
+  buf.retrieveAll();
+  BOOST_CHECK_EQUAL(buf.writableBytes(), 0);
+
+  // allocates again on append
+  buf.append(string(100, 'x'));
+  BOOST_CHECK(BufferPool::hasStorage(buf));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 100);
+  BOOST_CHECK_EQUAL(buf.prependableBytes(), Buffer::kCheapPrepend);
+  buf.prependInt32(100);
+  BOOST_CHECK_EQUAL(buf.readInt32(), 100);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(100, 'x'));
+
+  // reads into extrabuf, then appends
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::pipe(fds), 0);
+  BOOST_CHECK_EQUAL(::write(fds[1], "hello", 5), 5);
+  Buffer empty(BufferPool::emptyBuffer());
+  int savedErrno = 0;
+  BOOST_CHECK_EQUAL(empty.readFd(fds[0], &savedErrno), 5);
+  BOOST_CHECK_EQUAL(empty.retrieveAllAsString(), "hello");
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolReuse)
+{
+  BufferPool pool;
+  Buffer buf(BufferPool::emptyBuffer());
+  pool.acquire(&buf, 100);
+  BOOST_CHECK_EQUAL(buf.writableBytes(), Buffer::kInitialSize);
+  BOOST_CHECK_EQUAL(buf.prependableBytes(), Buffer::kCheapPrepend);
+  BOOST_CHECK_EQUAL(pool.numMisses(), 1);
+
+  buf.append(string(200, 'y'));
+  const char* storage = buf.peek();
+  buf.retrieveAll();
+  pool.release(&buf);
+  BOOST_CHECK(!BufferPool::hasStorage(buf));
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), Buffer::kCheapPrepend + Buffer::kInitialSize);
+
+  Buffer other(BufferPool::emptyBuffer());
+  pool.acquire(&other, 1000);
+  BOOST_CHECK_EQUAL(pool.numHits(), 1);
+  BOOST_CHECK_EQUAL(other.peek(), storage);
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), 0);
+
+  // 5000 bytes comes from the 16k class
+  pool.acquire(&buf, 5000);
+  BOOST_CHECK_EQUAL(buf.writableBytes(), 16 * 1024);
+  BOOST_CHECK_EQUAL(BufferPool::sizeClassOf(buf), 16 * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolShrink)
+{
+  BufferPool pool;
+  Buffer buf;
+  buf.append(string(4 * 1024 * 1024, 'z'));
+  buf.retrieveAll();
+  // megabytes go back to malloc
+  pool.release(&buf);
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.internalCapacity(), 0);
+
+  pool.setMaxPooledBytes(20 * 1024);
+  Buffer a(16 * 1024);
+  Buffer b(16 * 1024);
+  pool.release(&a);
+  pool.release(&b);
+  BOOST_CHECK(pool.pooledBytes() <= 20 * 1024);
+  BOOST_CHECK(pool.pooledBytes() >= 16 * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainWithPool)
+{
+  BufferPool pool;
+  BufferChain chain(&pool);
+  chain.append(string(1000, 'a'));
+  chain.append(string(100000, 'b'));
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+  chain.retrieve(1000);
+  // the drained chunk went to the pool
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), Buffer::kCheapPrepend + Buffer::kInitialSize);
+  chain.retrieve(100000);
+  BOOST_CHECK(chain.empty());
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+
+  chain.append(string(10, 'c'));
+  BOOST_CHECK(pool.numHits() >= 1);
+  struct iovec vec;
+  BOOST_CHECK_EQUAL(chain.peekIovec(&vec, 1), 1);
+  BOOST_CHECK_EQUAL(string(static_cast<const char*>(vec.iov_base), vec.iov_len), string(10, 'c'));
+  chain.retrieveAll();
+
+  // the Buffer given to an empty chain gets a usable storage back
+  Buffer body;
+  body.append(string(5000, 'z'));
+  chain.append(&body);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 5000);
+  BOOST_CHECK_EQUAL(body.prependableBytes(), Buffer::kCheapPrepend);
+  body.append("x", 1);
+  body.prependInt8(1);
+}
@@ -0,0 +1,104 @@
+#include "muduo/net/Buffer.h"
+#include "muduo/net/BufferSearch.h"
+#include "muduo/base/Timestamp.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char kCRLF[] = "\r\n";
+
+// keep the compiler from hoisting the search out of the loop
+template<typename T>
+void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// what Buffer::findCRLF() did before the SIMD kernels
+const char* findCRLFStdSearch(const Buffer& buf)
+{
+  const char* crlf = std::search(buf.peek(), buf.beginWrite(), kCRLF, kCRLF + 2);
+  return crlf == buf.beginWrite() ? NULL : crlf;
+}
+
+const char* findAnyOfStd(const Buffer& buf, const StringPiece& delims)
+{
+  const char* pos = std::find_first_of(buf.peek(), buf.beginWrite(),
+                                       delims.begin(), delims.end());
+  return pos == buf.beginWrite() ? NULL : pos;
+}
+
+// scan every line of the buffer, like HttpContext::parseRequest() does
+template<typename Find>
+void benchLines(const char* name, const Buffer& input, int times, Find find)
+{
+  size_t lines = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < times; ++i)
+  {
+    Buffer buf(input.readableBytes());
+    buf.append(input.peek(), input.readableBytes());
+    while (const char* crlf = find(buf))
+    {
+      buf.retrieveUntil(crlf + 2);
+      ++lines;
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  double mbytes = static_cast<double>(input.readableBytes()) * times / 1e6;
+  printf("%-24s %8.3f s %10.1f MB/s %zu lines\n", name, seconds, mbytes / seconds, lines);
+}
+
+template<typename Find>
+void benchScan(const char* name, const Buffer& input, int times, Find find)
+{
+  size_t found = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < times; ++i)
+  {
+    doNotOptimize(input.peek());
+    if (find(input))
+    {
+      ++found;
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  double mbytes = static_cast<double>(input.readableBytes()) * times / 1e6;
+  printf("%-24s %8.3f s %10.1f MB/s %zu found\n", name, seconds, mbytes / seconds, found);
+}
+
+int main()
+{
+  printf("kernel: %s\n", detail::searchKernelName());
+
+  Buffer request;
+  request.append("GET /index.html?user=muduo HTTP/1.1\r\n");
+  request.append("Host: www.chenshuo.com\r\n");
+  request.append("User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n");
+  request.append("Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n");
+  request.append("Accept-Encoding: gzip, deflate\r\n");
+  request.append("Accept-Language: en-US,en;q=0.8,zh-CN;q=0.6\r\n");
+  request.append("Cookie: session=0123456789abcdef0123456789abcdef\r\n");
+  request.append("\r\n");
+
+  puts("http request lines");
+  benchLines("std::search", request, 1000000, findCRLFStdSearch);
+  benchLines("Buffer::findCRLF", request, 1000000,
+             [](const Buffer& buf) { return buf.findCRLF(); });
+
+  Buffer body;
+  body.append(string(64 * 1024, 'x'));
+  body.append("\r\n");
+
+  puts("64k body without CRLF");
+  benchScan("std::search", body, 20000, findCRLFStdSearch);
+  benchScan("Buffer::findCRLF", body, 20000,
+            [](const Buffer& buf) { return buf.findCRLF(); });
+  benchScan("std::find_first_of", body, 20000,
+            [](const Buffer& buf) { return findAnyOfStd(buf, " \r\n"); });
+  benchScan("Buffer::findAnyOf", body, 20000,
+            [](const Buffer& buf) { return buf.findAnyOf(" \r\n"); });
+}
@@ -1,10 +1,16 @@
 #include "muduo/net/Buffer.h"
+#include "muduo/net/BufferSearch.h"
 
 //#define BOOST_TEST_MODULE BufferTest
 #define BOOST_TEST_MAIN
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <random>
+
+#include <unistd.h>
+
 using muduo::string;
 using muduo::net::Buffer;
 
@@ -152,6 +158,167 @@ BOOST_AUTO_TEST_CASE(testBufferFindEOL)
   BOOST_CHECK_EQUAL(buf.findEOL(buf.peek()+90000), null);
 }
 
+BOOST_AUTO_TEST_CASE(testBufferFindCRLF)
+{
+  const char* null = NULL;
+  // cover the scalar tail and both 16 and 32 bytes blocks
+  for (size_t pos = 0; pos < 100; ++pos)
+  {
+    Buffer buf;
+    buf.append(string(pos, 'x'));
+    buf.append("\r\n");
+    buf.append(string(70, 'y'));
+    BOOST_CHECK_EQUAL(buf.findCRLF(), buf.peek() + pos);
+    BOOST_CHECK_EQUAL(buf.findCRLF(buf.peek() + pos + 1), null);
+  }
+
+  Buffer buf;
+  buf.append(string(40, '\r'));
+  buf.append(string(40, '\n'));
+  BOOST_CHECK_EQUAL(buf.findCRLF(), buf.peek() + 39);
+
+  // '\r' at the end, '\n' not yet received
+  Buffer half;
+  half.append(string(63, 'x'));
+  half.append("\r");
+  BOOST_CHECK_EQUAL(half.findCRLF(), null);
+  half.append("\n");
+  BOOST_CHECK_EQUAL(half.findCRLF(), half.peek() + 63);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferFindAnyOf)
+{
+  const char* null = NULL;
+  for (size_t pos = 0; pos < 100; ++pos)
+  {
+    Buffer buf;
+    buf.append(string(pos, 'x'));
+    buf.append(":");
+    buf.append(string(70, ' '));
+    BOOST_CHECK_EQUAL(buf.findAnyOf(":\r\n"), buf.peek() + pos);
+    BOOST_CHECK_EQUAL(buf.findAnyOf("\r\n"), null);
+    BOOST_CHECK_EQUAL(buf.findAnyOf(" "), buf.peek() + pos + 1);
+  }
+
+  Buffer buf;
+  buf.append(string(100, 'x'));
+  buf.append("z");
+  BOOST_CHECK_EQUAL(buf.findAnyOf("abcdefghijklmnopqrstuvwyz"), buf.peek() + 100);
+  BOOST_CHECK_EQUAL(buf.findAnyOf(""), null);
+}
+
+namespace
+{
+
+const char* findCRLFReference(const char* begin, const char* end)
+{
+  const char kCRLF[] = "\r\n";
+  const char* crlf = std::search(begin, end, kCRLF, kCRLF + 2);
+  return crlf == end ? NULL : crlf;
+}
+
+const char* findAnyOfReference(const char* begin, const char* end,
+                               const char* delims, size_t ndelims)
+{
+  const char* pos = std::find_first_of(begin, end, delims, delims + ndelims);
+  return pos == end ? NULL : pos;
+}
+
+}  // namespace
+
+// Every kernel this CPU can run, not only the one picked at runtime, against
+// std::search() and std::find_first_of(). Matches and lone '\r' are placed on
+// both sides of the 16, 32 and 128 bytes blocks, at unaligned starts.
+BOOST_AUTO_TEST_CASE(testSearchKernels)
+{
+  using namespace muduo::net::detail;
+  SearchKernels kernels[8];
+  const size_t nkernels = availableSearchKernels(kernels, 8);
+  BOOST_REQUIRE_GE(nkernels, 1u);
+  BOOST_CHECK_EQUAL(kernels[0].name, string("scalar"));
+
+  // 1 and 3 delimiters, more than the 8 of AVX2 and the 16 of PCMPESTRI
+  const string delimSets[] = { ":", ":\r\n", "0123456789", "abcdefghijklmnopqrstu" };
+  std::mt19937 rng(2);
+  char data[512];
+  for (size_t k = 0; k < nkernels; ++k)
+  {
+    BOOST_TEST_MESSAGE("kernel " << kernels[k].name);
+    int mismatches = 0;
+    for (size_t len = 0; len <= 300; ++len)
+    {
+      for (size_t offset = 0; offset < 4; ++offset)
+      {
+        const char* begin = data + offset;
+        const char* end = begin + len;
+        // one "\r\n" or delimiter at each position, a lone '\r' just before it
+        for (size_t pos = 0; pos <= len; ++pos)
+        {
+          std::fill(data, data + sizeof data, 'x');
+          if (pos > 1)
+          {
+            data[offset + pos - 2] = '\r';
+          }
+          if (pos + 2 <= len)
+          {
+            data[offset + pos] = '\r';
+            data[offset + pos + 1] = '\n';
+          }
+          else if (pos < len)
+          {
+            data[offset + pos] = '\r';  // '\n' not received yet
+          }
+          // a '\n' completing a trailing '\r' and a match just past the end
+          // must not be seen
+          data[offset + len] = '\n';
+          data[offset + len + 1] = '\r';
+          data[offset + len + 2] = '\n';
+          if (kernels[k].findCRLF(begin, end) != findCRLFReference(begin, end))
+          {
+            ++mismatches;
+          }
+
+          std::fill(data, data + sizeof data, 'x');
+          for (const string& delims : delimSets)
+          {
+            if (pos < len)
+            {
+              data[offset + pos] = delims[rng() % delims.size()];
+            }
+            data[offset + len] = delims[0];
+            if (kernels[k].findAnyOf(begin, end, delims.data(), delims.size())
+                != findAnyOfReference(begin, end, delims.data(), delims.size()))
+            {
+              ++mismatches;
+            }
+          }
+        }
+      }
+    }
+    BOOST_CHECK_MESSAGE(mismatches == 0,
+                        kernels[k].name << ": " << mismatches << " mismatches");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testBufferReadFdLen)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::pipe(fds), 0);
+  const string data(3000, 'r');
+  BOOST_CHECK_EQUAL(::write(fds[1], data.data(), data.size()), 3000);
+
+  Buffer buf;
+  buf.append("head", 4);
+  int savedErrno = 0;
+  // makes room for len bytes, reads no more than that
+  BOOST_CHECK_EQUAL(buf.readFd(fds[0], 2048, &savedErrno), 2048);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 4 + 2048);
+  BOOST_CHECK_EQUAL(buf.readFd(fds[0], 2048, &savedErrno), 3000 - 2048);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "head" + data);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
 void output(Buffer&& buf, const void* inner)
 {
   Buffer newbuf(std::move(buf));
@@ -0,0 +1,78 @@
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 测量跨线程queueInLoop()到回调执行的延迟，对比阻塞和忙轮询
+
+const int kRounds = 10000;
+
+std::atomic<int64_t> g_ranAt(0);
+
+void setBusyPoll(int microseconds, EventLoop* loop)
+{
+  loop->setBusyPoll(microseconds);
+}
+
+void run(int busyPollUs)
+{
+  EventLoopThread thread(std::bind(setBusyPoll, busyPollUs, std::placeholders::_1));
+  EventLoop* loop = thread.startLoop();
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(kRounds);
+  for (int i = 0; i < kRounds; ++i)
+  {
+    g_ranAt = 0;
+    int64_t start = Timestamp::now().microSecondsSinceEpoch();
+    loop->queueInLoop([] { g_ranAt = Timestamp::now().microSecondsSinceEpoch(); });
+    while (g_ranAt == 0)
+    {
+    }
+    latencies.push_back(g_ranAt - start);
+    // 间隔一小段时间，让阻塞模式的IO线程真正睡下去
+    int64_t pause = Timestamp::now().microSecondsSinceEpoch() + 20;
+    while (Timestamp::now().microSecondsSinceEpoch() < pause)
+    {
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::atomic<bool> done(false);
+  int64_t spins = 0, spinUs = 0, hits = 0;
+  loop->runInLoop([&] {
+    spins = loop->busyPollSpins();
+    spinUs = loop->busyPollMicroseconds();
+    hits = loop->busyPollHits();
+    done = true;
+  });
+  while (!done)
+  {
+  }
+  printf("busy poll %5d us: latency p50 %3" PRId64 " us p99 %3" PRId64 " us max %5" PRId64 " us, "
+         "spins %" PRId64 " in %" PRId64 " us, hits %" PRId64 "\n",
+         busyPollUs,
+         latencies[kRounds / 2], latencies[kRounds * 99 / 100], latencies.back(),
+         spins, spinUs, hits);
+}
+
+int main(int argc, char* argv[])
+{
+  int busyPollUs = argc > 1 ? atoi(argv[1]) : 1000;
+  run(0);
+  run(busyPollUs);
+}
@@ -0,0 +1,231 @@
+// Moves live connections between the I/O threads of an echo server.
+// Clients keep sending numbered lines and check the echoes, so a move must
+// not lose, duplicate or reorder any data. The server closes the connections
+// of all but the first I/O thread, the rebalancer must spread the rest out
+// again. Then every connection is moved to the next thread by hand.
+//
+// connectionmove_test [0|1]   1 for edge triggered
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kClients = 12;
+const int kThreads = 3;
+
+EventLoop* g_loop;
+TcpServer* g_server;
+std::atomic<int> g_moved(0);
+std::atomic<int> g_notMoved(0);
+int g_errors = 0;
+int g_closed = 0;
+
+MutexLock g_mutex;
+std::set<TcpConnectionPtr> g_serverConns;
+
+struct Client
+{
+  std::unique_ptr<TcpClient> client;
+  int sent = 0;
+  int received = 0;
+};
+
+Client g_clients[kClients];
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  MutexLockGuard lock(g_mutex);
+  if (conn->connected())
+  {
+    g_serverConns.insert(conn);
+  }
+  else
+  {
+    g_serverConns.erase(conn);
+  }
+}
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onMoved(const TcpConnectionPtr& conn, bool moved)
+{
+  assert(conn->getLoop()->isInLoopThread());
+  if (moved)
+  {
+    ++g_moved;
+  }
+  else
+  {
+    ++g_notMoved;
+  }
+}
+
+void onClientMessage(Client* c, const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  const char* eol;
+  while ((eol = buf->findEOL()) != NULL)
+  {
+    int n = atoi(buf->peek());
+    if (n != c->received)
+    {
+      LOG_ERROR << "expect " << c->received << " got " << n;
+      ++g_errors;
+    }
+    c->received = n + 1;
+    buf->retrieveUntil(eol + 1);
+  }
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    ++g_closed;
+  }
+}
+
+void sendAll()
+{
+  for (Client& c : g_clients)
+  {
+    TcpConnectionPtr conn = c.client->connection();
+    if (conn && conn->connected())
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "%d\n", c.sent++);
+      conn->send(buf);
+    }
+  }
+}
+
+std::vector<int> connectionsPerLoop()
+{
+  std::vector<int> counts;
+  printf("connections per loop:");
+  for (EventLoop* loop : g_server->threadPool()->getAllLoops())
+  {
+    counts.push_back(loop->numConnections());
+    printf(" %d", counts.back());
+  }
+  printf(", moved %d, not moved %d\n", g_moved.load(), g_notMoved.load());
+  return counts;
+}
+
+void closeOthers()
+{
+  connectionsPerLoop();
+  EventLoop* first = g_server->threadPool()->getAllLoops()[0];
+  MutexLockGuard lock(g_mutex);
+  for (const TcpConnectionPtr& conn : g_serverConns)
+  {
+    if (conn->getLoop() != first)
+    {
+      conn->forceClose();
+    }
+  }
+}
+
+void moveAll()
+{
+  connectionsPerLoop();
+  std::vector<EventLoop*> loops = g_server->threadPool()->getAllLoops();
+  MutexLockGuard lock(g_mutex);
+  for (const TcpConnectionPtr& conn : g_serverConns)
+  {
+    size_t i = std::find(loops.begin(), loops.end(), conn->getLoop()) - loops.begin();
+    conn->moveToLoop(loops[(i + 1) % loops.size()], onMoved);
+  }
+}
+
+void disconnectAll()
+{
+  connectionsPerLoop();
+  for (Client& c : g_clients)
+  {
+    c.client->disconnect();
+  }
+}
+
+void finish()
+{
+  std::vector<int> counts = connectionsPerLoop();
+  int total = 0;
+  for (int n : counts)
+  {
+    total += n;
+  }
+  if (g_closed == kClients && total == 0)
+  {
+    g_loop->quit();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool edgeTriggered = argc > 1 && atoi(argv[1]) != 0;
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(2022, true);
+  TcpServer server(&loop, listenAddr, "MoveServer");
+  g_server = &server;
+  server.setThreadNum(kThreads);
+  server.setEdgeTriggered(edgeTriggered);
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onServerMessage);
+  server.setRebalance(0.2, onMoved);
+  server.start();
+
+  for (int i = 0; i < kClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "MoveClient%d", i);
+    Client& c = g_clients[i];
+    c.client.reset(new TcpClient(&loop, InetAddress("127.0.0.1", 2022), name));
+    c.client->setConnectionCallback(onClientConnection);
+    c.client->setMessageCallback(std::bind(onClientMessage, &c, _1, _2, _3));
+    c.client->connect();
+  }
+  loop.runEvery(0.005, sendAll);
+  loop.runAfter(1.0, closeOthers);
+  std::vector<int> balanced;
+  loop.runAfter(3.0, [&balanced] { balanced = connectionsPerLoop(); });
+  loop.runAfter(3.1, moveAll);
+  loop.runAfter(4.0, disconnectAll);
+  loop.runEvery(0.5, finish);
+  loop.runAfter(30.0, [] {
+    LOG_ERROR << "timeout";
+    g_loop->quit();
+  });
+  loop.loop();
+
+  int received = 0;
+  for (Client& c : g_clients)
+  {
+    received += c.received;
+    c.client.reset();
+  }
+  // 第一个线程剩下kClients/kThreads个连接，再平衡后每个线程至少一个
+  bool ok = g_errors == 0 && g_closed == kClients
+    && balanced.size() == kThreads
+    && *std::min_element(balanced.begin(), balanced.end()) >= 1
+    && g_moved >= kClients / kThreads;
+  printf("edge triggered %d, %d lines echoed, %d moves, %d errors, %s\n",
+         edgeTriggered, received, g_moved.load(), g_errors, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Request/response with coroutines on both sides: the client sends a size
+// line and a body, the server sleeps a little and answers with the body
+// reversed, then the client shuts down and waits for the server to close.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Coroutine.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2021;
+const int kRequests = 100;
+
+int g_served = 0;
+int g_answered = 0;
+bool g_closed = false;
+
+Task<> serverSession(CoConnection conn)
+{
+  for (;;)
+  {
+    string header = co_await conn.readUntil("\r\n");
+    if (header.empty())
+    {
+      break;
+    }
+    size_t size = static_cast<size_t>(atoi(header.c_str()));
+    string body = co_await conn.read(size);
+    if (body.size() < size)
+    {
+      break;
+    }
+    co_await sleepFor(conn.loop(), 0.001);
+    std::reverse(body.begin(), body.end());
+    conn.send(std::move(body));
+    co_await conn.drain();
+    ++g_served;
+  }
+  conn.shutdown();
+}
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    serverSession(CoConnection::attach(conn)).detach();
+  }
+}
+
+Task<bool> call(CoConnection& conn, int i)
+{
+  string body(static_cast<size_t>(i * 1000 + 2), 'a');
+  body.back() = 'z';
+  char header[32];
+  snprintf(header, sizeof header, "%zu\r\n", body.size());
+  conn.send(header);
+  conn.send(body);
+  string reply = co_await conn.read(body.size());
+  co_return reply.size() == body.size() && reply.front() == 'z' && reply.back() == 'a';
+}
+
+Task<> client(EventLoop* loop)
+{
+  CoConnection conn = co_await connectTo(loop, InetAddress("127.0.0.1", kPort), "CoroutineClient");
+  for (int i = 0; i < kRequests; ++i)
+  {
+    if (!co_await call(conn, i))
+    {
+      LOG_ERROR << "bad reply " << i;
+      break;
+    }
+    ++g_answered;
+  }
+  conn.shutdown();
+  string eof = co_await conn.read(1);
+  g_closed = eof.empty();
+  loop->quit();
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort, true), "CoroutineServer");
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+
+  client(&loop).detach();
+  loop.runAfter(30.0, [&loop] {
+    LOG_ERROR << "timeout";
+    loop.quit();
+  });
+  loop.loop();
+
+  bool ok = g_served == kRequests && g_answered == kRequests && g_closed;
+  printf("served %d, answered %d, closed %d, %s\n",
+         g_served, g_answered, g_closed, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
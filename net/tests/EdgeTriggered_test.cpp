@@ -0,0 +1,113 @@
+// Request/response over loopback with the server in edge triggered mode.
+// Requests are larger than the read budget, responses are larger than the
+// socket buffer, so the server keeps reading after the budget is used up,
+// writes partially and waits for POLLOUT on every response. The server also
+// pauses reading now and then, data that arrives meanwhile must not be lost.
+//
+// edgetriggered_test [0|1]   1 (default) for edge triggered
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kRequests = 300;
+const size_t kRequestSize = 64 * 1024;
+const size_t kResponseSize = 4 * 1024 * 1024;
+
+EventLoop* g_loop;
+int g_served = 0;
+int g_completed = 0;
+size_t g_received = 0;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setReadBudget(16 * 1024);
+  }
+}
+
+void onRequest(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  while (buf->readableBytes() >= kRequestSize)
+  {
+    buf->retrieve(kRequestSize);
+    conn->send(string(kResponseSize, 'r'));
+    if (++g_served % 16 == 0)
+    {
+      conn->stopRead();
+      g_loop->runAfter(0.001, std::bind(&TcpConnection::startRead, conn));
+    }
+  }
+}
+
+void sendRequest(const TcpConnectionPtr& conn)
+{
+  conn->send(string(kRequestSize, 'q'));
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    sendRequest(conn);
+  }
+  else
+  {
+    g_loop->quit();
+  }
+}
+
+void onResponse(TcpClient* client, const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+  while (g_received >= kResponseSize)
+  {
+    g_received -= kResponseSize;
+    if (++g_completed < kRequests)
+    {
+      sendRequest(conn);
+    }
+    else
+    {
+      client->disconnect();
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool edgeTriggered = argc > 1 ? atoi(argv[1]) != 0 : true;
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(2020, true);
+  TcpServer server(&loop, listenAddr, "EdgeTriggeredServer");
+  server.setEdgeTriggered(edgeTriggered);
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onRequest);
+  server.start();
+
+  TcpClient client(&loop, InetAddress("127.0.0.1", 2020), "EdgeTriggeredClient");
+  client.setConnectionCallback(onClientConnection);
+  client.setMessageCallback(std::bind(onResponse, &client, _1, _2, _3));
+  client.connect();
+  loop.runAfter(60.0, [] {
+    LOG_ERROR << "timeout";
+    g_loop->quit();
+  });
+  loop.loop();
+
+  bool ok = g_completed == kRequests && g_served == kRequests;
+  printf("edge triggered %d, %d requests served, %d completed, %s\n",
+         edgeTriggered, g_served, g_completed, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
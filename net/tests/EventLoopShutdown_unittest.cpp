@@ -0,0 +1,239 @@
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+
+//#define BOOST_TEST_MODULE EventLoopShutdownTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using muduo::CountDownLatch;
+using muduo::Thread;
+using muduo::net::EventLoop;
+using muduo::net::TimerId;
+
+BOOST_AUTO_TEST_CASE(testQuitBeforeLoop)
+{
+  EventLoop loop;
+  // 如果quit()丢了，由这个定时器结束，但是已经循环过了
+  loop.runAfter(2.0, [&loop] { loop.quit(); });
+  loop.quit();
+  loop.loop();
+  BOOST_CHECK_EQUAL(loop.iteration(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testQuitFromOtherThreadBeforeLoop)
+{
+  // 和EventLoopThread刚启动就析构一样，quit()在loop()之前从别的线程调用
+  EventLoop* loop = NULL;
+  int64_t iterations = -1;
+  CountDownLatch created(1);
+  CountDownLatch quitted(1);
+  Thread thread([&] {
+    EventLoop threadLoop;
+    threadLoop.runAfter(2.0, [&threadLoop] { threadLoop.quit(); });
+    loop = &threadLoop;
+    created.countDown();
+    quitted.wait();
+    threadLoop.loop();
+    iterations = threadLoop.iteration();
+  });
+  thread.start();
+  created.wait();
+  loop->quit();
+  quitted.countDown();
+  thread.join();
+  BOOST_CHECK_EQUAL(iterations, 0);
+}
+
+BOOST_AUTO_TEST_CASE(testLoopAgainAfterQuit)
+{
+  EventLoop loop;
+  TimerId guard = loop.runAfter(2.0, [&loop] { loop.quit(); });
+  loop.quit();
+  loop.loop();
+  BOOST_CHECK_EQUAL(loop.iteration(), 0);
+  loop.cancel(guard);
+
+  // 上一次的quit()不影响下一次loop()
+  bool ran = false;
+  loop.runAfter(0.01, [&] {
+    ran = true;
+    loop.quit();
+  });
+  loop.loop();
+  BOOST_CHECK(ran);
+  BOOST_CHECK_GT(loop.iteration(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testQuitAfterLoopReturnsStopsNextLoop)
+{
+  EventLoop loop;
+  loop.runAfter(0.01, [&loop] { loop.quit(); });
+  loop.loop();
+  const int64_t iterations = loop.iteration();
+  BOOST_CHECK_GT(iterations, 0);
+
+  // loop()返回之后的quit()留给下一次loop()，它不poll就返回
+  TimerId guard = loop.runAfter(2.0, [&loop] { loop.quit(); });
+  loop.quit();
+  loop.loop();
+  BOOST_CHECK_EQUAL(loop.iteration(), iterations);
+  loop.cancel(guard);
+}
+
+BOOST_AUTO_TEST_CASE(testFinalPassIsBounded)
+{
+  std::vector<int> ran;
+  std::shared_ptr<int> token(new int(0));
+  std::weak_ptr<int> watcher(token);
+  {
+    EventLoop loop;
+    loop.queueInLoop([&, token] {
+      ran.push_back(1);
+      loop.quit();
+      // 这个在loop()返回前的最后一遍执行，它再加入的不执行
+      loop.queueInLoop([&, token] {
+        ran.push_back(2);
+        loop.queueInLoop([&, token] { ran.push_back(3); });
+      });
+    });
+    token.reset();
+    loop.loop();
+    BOOST_CHECK(!watcher.expired());
+  }
+  BOOST_CHECK(watcher.expired());
+  BOOST_REQUIRE_EQUAL(ran.size(), 2u);
+  BOOST_CHECK_EQUAL(ran[0], 1);
+  BOOST_CHECK_EQUAL(ran[1], 2);
+}
+
+void requeue(EventLoop* loop, int* count)
+{
+  ++*count;
+  loop->queueInLoop(std::bind(requeue, loop, count));
+}
+
+BOOST_AUTO_TEST_CASE(testQuitWithSelfRequeueingFunctor)
+{
+  EventLoop loop;
+  int count = 0;
+  loop.queueInLoop(std::bind(requeue, &loop, &count));
+  loop.runAfter(0.01, [&loop] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK_GT(count, 0);
+}
+
+BOOST_AUTO_TEST_CASE(testQuitWhileOtherThreadKeepsQueueing)
+{
+  // 别的线程一直在加入，比如跨线程的send()，loop()也要返回
+  EventLoop* loop = NULL;
+  CountDownLatch started(1);
+  CountDownLatch stopped(1);
+  std::atomic<bool> returned(false);
+  std::atomic<int> ran(0);
+  Thread thread([&] {
+    EventLoop threadLoop;
+    loop = &threadLoop;
+    threadLoop.runInLoop([&started] { started.countDown(); });
+    threadLoop.loop();
+    returned = true;
+    stopped.wait();
+  });
+  thread.start();
+  started.wait();
+  for (int i = 0; !returned; ++i)
+  {
+    loop->queueInLoop([&ran] { ++ran; });
+    if (i == 1000)
+    {
+      loop->quit();
+    }
+  }
+  stopped.countDown();
+  thread.join();
+  BOOST_CHECK_GT(ran.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testQueuedAfterLoopReturnsRunsInNextLoop)
+{
+  EventLoop loop;
+  loop.quit();
+  loop.loop();
+  bool ran = false;
+  loop.queueInLoop([&] { ran = true; });
+  loop.queueInLoop([&] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK(ran);
+}
+
+BOOST_AUTO_TEST_CASE(testShutdownFromOtherThreads)
+{
+  const int kFunctors = 1000;
+  EventLoop* loop = NULL;
+  CountDownLatch started(1);
+  CountDownLatch queued(1);
+  CountDownLatch returned(1);
+  CountDownLatch destroy(1);
+  std::atomic<int> ranInLoop(0);
+  std::atomic<int> ranElsewhere(0);
+  Thread thread([&] {
+    EventLoop threadLoop;
+    loop = &threadLoop;
+    threadLoop.runInLoop([&started] { started.countDown(); });
+    threadLoop.loop();
+    returned.countDown();
+    // loop()返回之后，析构之前，别的线程还在加入
+    destroy.wait();
+  });
+  thread.start();
+  started.wait();
+
+  auto count = [&] {
+    if (loop->isInLoopThread())
+    {
+      ++ranInLoop;
+    }
+    else
+    {
+      ++ranElsewhere;
+    }
+  };
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    loop->queueInLoop(count);
+  }
+  // 这个回调执行时已经quit()，下面加入的都在loop()返回前的最后一遍执行
+  loop->queueInLoop([&] {
+    loop->quit();
+    queued.wait();
+  });
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    loop->queueInLoop(count);
+  }
+  queued.countDown();
+  returned.wait();
+  BOOST_CHECK_EQUAL(ranInLoop.load(), 2 * kFunctors);
+  BOOST_CHECK_EQUAL(ranElsewhere.load(), 0);
+
+  // loop()返回之后加入的不执行，随EventLoop销毁
+  std::shared_ptr<int> token(new int(0));
+  std::weak_ptr<int> watcher(token);
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    loop->queueInLoop([&count, token] { count(); });
+  }
+  token.reset();
+  BOOST_CHECK(!watcher.expired());
+  destroy.countDown();
+  thread.join();
+  BOOST_CHECK(watcher.expired());
+  BOOST_CHECK_EQUAL(ranInLoop.load(), 2 * kFunctors);
+  BOOST_CHECK_EQUAL(ranElsewhere.load(), 0);
+}
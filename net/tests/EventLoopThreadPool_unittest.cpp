@@ -2,6 +2,7 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/base/Thread.h"
 
+#include <sched.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -20,6 +21,31 @@ void init(EventLoop* p)
          getpid(), CurrentThread::tid(), p);
 }
 
+int firstCpu()
+{
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  sched_getaffinity(0, sizeof cpus, &cpus);
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+  {
+    if (CPU_ISSET(cpu, &cpus))
+    {
+      return cpu;
+    }
+  }
+  return 0;
+}
+
+void initPinned(int cpu, EventLoop* p)
+{
+  init(p);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  sched_getaffinity(0, sizeof cpus, &cpus);
+  assert(CPU_COUNT(&cpus) == 1 && CPU_ISSET(cpu, &cpus));
+  (void)cpu;
+}
+
 int main()
 {
   print();
@@ -63,6 +89,44 @@ int main()
     assert(nextLoop == model.getNextLoop());
   }
 
+  {
+    printf("Least connections:\n");
+    EventLoopThreadPool model(&loop, "least");
+    model.setThreadNum(3);
+    model.setLoopSelection(EventLoopThreadPool::kLeastConnections);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    loops[0]->adjustConnections(2);
+    loops[2]->adjustConnections(1);
+    assert(model.getNextLoop() == loops[1]);
+    loops[1]->adjustConnections(2);
+    assert(model.getNextLoop() == loops[2]);
+
+    printf("Power of two choices:\n");
+    model.setLoopSelection(EventLoopThreadPool::kPowerOfTwoChoices);
+    loops[0]->adjustConnections(8);
+    for (int i = 0; i < 100; ++i)
+    {
+      assert(model.getNextLoop() != loops[0]);
+    }
+  }
+
+  {
+    printf("Pinned, parallel start:\n");
+    int cpu = firstCpu();
+    EventLoopThreadPool model(&loop, "pinned");
+    model.setThreadNum(3);
+    model.setCpuAffinity(std::vector<int>(1, cpu));
+    model.setNumaLocal(true);
+    model.setParallelStart(true);
+    model.start(std::bind(initPinned, cpu, _1));
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    assert(loops.size() == 3);
+    assert(model.getLoopForCpu(cpu) == loops[0]);
+    assert(model.getLoopForCpu(cpu + 1) == NULL);
+    assert(model.getLoopForCpu(-1) == NULL);
+  }
+
   loop.loop();
 }
 
@@ -0,0 +1,105 @@
+// The server closes connections which sent nothing for 0.5 second.
+// One client keeps sending and must stay connected, a silent one must be
+// closed in time. The silent client counts its own all-idle events on the way,
+// they must repeat every 0.1 second.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+EventLoop* g_loop;
+Timestamp g_start;
+double g_silentClosed = -1;
+bool g_activeClosed = false;
+bool g_finishing = false;
+int g_idleEvents = 0;
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onActiveConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    if (g_finishing)
+    {
+      g_loop->quit();
+    }
+    else
+    {
+      g_activeClosed = true;
+    }
+  }
+}
+
+void onSilentConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    g_silentClosed = timeDifference(Timestamp::now(), g_start);
+  }
+}
+
+void onSilentIdle(const TcpConnectionPtr&, IdleEvent event)
+{
+  if (event == kAllIdle)
+  {
+    ++g_idleEvents;
+  }
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(2023, true);
+  TcpServer server(&loop, listenAddr, "IdleServer");
+  server.setThreadNum(2);
+  server.setMessageCallback(onServerMessage);
+  server.setIdleTimeout(0.5, 0, 0);
+  server.start();
+
+  TcpClient active(&loop, InetAddress("127.0.0.1", 2023), "Active");
+  active.setConnectionCallback(onActiveConnection);
+  active.connect();
+  TcpClient silent(&loop, InetAddress("127.0.0.1", 2023), "Silent");
+  silent.setConnectionCallback(onSilentConnection);
+  silent.setIdleTimeout(0, 0, 0.1, onSilentIdle);
+  silent.connect();
+
+  g_start = Timestamp::now();
+  loop.runEvery(0.1, [&active] {
+    TcpConnectionPtr conn = active.connection();
+    if (conn && conn->connected())
+    {
+      conn->send("ping\n");
+    }
+  });
+  loop.runAfter(1.5, [&active] {
+    g_finishing = true;
+    active.disconnect();
+  });
+  loop.runAfter(10.0, [] {
+    LOG_ERROR << "timeout";
+    g_loop->quit();
+  });
+  loop.loop();
+
+  // 0.5秒超时，最多晚0.1秒的tick和timer的slack
+  bool ok = !g_activeClosed
+    && g_silentClosed >= 0.5 && g_silentClosed < 0.8
+    && g_idleEvents >= 2;
+  printf("silent closed after %.3fs with %d idle events, active %s, %s\n",
+         g_silentClosed, g_idleEvents, g_activeClosed ? "closed" : "connected",
+         ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
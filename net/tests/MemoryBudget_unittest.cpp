@@ -0,0 +1,54 @@
+#include "muduo/net/MemoryBudget.h"
+
+//#define BOOST_TEST_MODULE MemoryBudgetTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::net::MemoryBudget;
+using muduo::net::TcpConnectionPtr;
+
+BOOST_AUTO_TEST_CASE(testMemoryBudgetLevels)
+{
+  MemoryBudget budget(1000 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kNormal);
+  BOOST_CHECK(budget.admit());
+
+  budget.charge(500 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kNormal);
+  budget.charge(200 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kPauseReading);
+  BOOST_CHECK(budget.admit());
+  budget.charge(200 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kRejectNew);
+  BOOST_CHECK(!budget.admit());
+  BOOST_CHECK_EQUAL(budget.numRejected(), 1);
+  // no connection to shed
+  budget.charge(200 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kShed);
+  BOOST_CHECK_EQUAL(budget.numShed(), 0);
+
+  budget.charge(-1100 * 1000);
+  BOOST_CHECK_EQUAL(budget.used(), 0);
+  BOOST_CHECK_EQUAL(budget.peak(), 1100 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kNormal);
+  BOOST_CHECK(budget.admit());
+}
+
+BOOST_AUTO_TEST_CASE(testMemoryBudgetRatios)
+{
+  MemoryBudget budget(1000 * 1000);
+  budget.setRatios(0.5, 0.9);
+  budget.charge(600 * 1000);
+  BOOST_CHECK_EQUAL(budget.level(), MemoryBudget::kPauseReading);
+  BOOST_CHECK(budget.admit());
+
+  // small connections are never paused
+  BOOST_CHECK(!budget.pauseReading(TcpConnectionPtr(), MemoryBudget::kMinHeavyBytes - 1));
+  BOOST_CHECK_EQUAL(budget.numPaused(), 0);
+
+  string report = budget.report();
+  BOOST_CHECK(report.find("used 600000 bytes of 1000000") != string::npos);
+  BOOST_CHECK(report.find("level pause reading") != string::npos);
+}
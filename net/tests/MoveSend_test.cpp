@@ -0,0 +1,179 @@
+// A thread which is none of the I/O threads keeps sending numbered lines on
+// a server connection, with all the send() overloads, while another thread
+// keeps moving the connection between the I/O threads. The client must get
+// every line once and in order.
+//
+// movesend_test [0|1]   1 for edge triggered
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2028;
+const int kLines = 100000;
+const int kThreads = 3;
+
+EventLoop* g_loop;
+std::vector<EventLoop*> g_ioLoops;
+TcpConnectionPtr g_serverConn;
+CountDownLatch g_connected(1);
+std::atomic<bool> g_sending(true);
+std::atomic<int> g_moved(0);
+std::atomic<int> g_wrongLoop(0);
+int g_received = 0;
+int g_errors = 0;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_serverConn = conn;
+    g_connected.countDown();
+  }
+}
+
+void onMoved(const TcpConnectionPtr& conn, bool moved)
+{
+  if (!conn->getLoop()->isInLoopThread())
+  {
+    ++g_wrongLoop;
+  }
+  if (moved)
+  {
+    ++g_moved;
+  }
+}
+
+void sendLines()
+{
+  g_connected.wait();
+  TcpConnectionPtr conn = g_serverConn;
+  if (!conn)
+  {
+    return;
+  }
+  for (int i = 0; i < kLines; ++i)
+  {
+    char line[32];
+    snprintf(line, sizeof line, "%d\n", i);
+    switch (i % 3)
+    {
+    case 0:
+      conn->send(line);
+      break;
+    case 1:
+      conn->send(string(line));
+      break;
+    default:
+      {
+        Buffer buf;
+        buf.append(line);
+        conn->send(std::move(buf));
+      }
+    }
+    if (i % 50 == 0)
+    {
+      // 让输出缓冲区清空，连接才能移动
+      usleep(20);
+    }
+  }
+  g_sending = false;
+}
+
+void moveAround()
+{
+  g_connected.wait();
+  TcpConnectionPtr conn = g_serverConn;
+  if (!conn)
+  {
+    return;
+  }
+  while (g_sending)
+  {
+    // 在这个线程中读getLoop()，连接随时可能正在移动
+    size_t i = std::find(g_ioLoops.begin(), g_ioLoops.end(), conn->getLoop()) - g_ioLoops.begin();
+    conn->moveToLoop(g_ioLoops[(i + 1) % g_ioLoops.size()], onMoved);
+    usleep(200);
+  }
+}
+
+void onClientMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  const char* eol;
+  while ((eol = buf->findEOL()) != NULL)
+  {
+    int n = atoi(buf->peek());
+    if (n != g_received)
+    {
+      LOG_ERROR << "expect " << g_received << " got " << n;
+      ++g_errors;
+    }
+    g_received = n + 1;
+    buf->retrieveUntil(eol + 1);
+  }
+  if (g_received == kLines)
+  {
+    // 服务器端的连接还被g_serverConn持有，由客户端关闭
+    conn->forceClose();
+  }
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    g_loop->quit();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool edgeTriggered = argc > 1 && atoi(argv[1]) != 0;
+  EventLoop loop;
+  g_loop = &loop;
+  TcpServer server(&loop, InetAddress(kPort, true), "MoveSendServer");
+  server.setThreadNum(kThreads);
+  server.setEdgeTriggered(edgeTriggered);
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+  g_ioLoops = server.threadPool()->getAllLoops();
+
+  TcpClient client(&loop, InetAddress("127.0.0.1", kPort), "MoveSendClient");
+  client.setConnectionCallback(onClientConnection);
+  client.setMessageCallback(onClientMessage);
+  client.connect();
+
+  Thread sender(sendLines, "sender");
+  Thread mover(moveAround, "mover");
+  sender.start();
+  mover.start();
+  loop.runAfter(30.0, [] {
+    LOG_ERROR << "timeout";
+    g_loop->quit();
+  });
+  loop.loop();
+  g_connected.countDown();
+  g_sending = false;
+  sender.join();
+  mover.join();
+  g_serverConn.reset();
+
+  bool ok = g_received == kLines && g_errors == 0 && g_wrongLoop == 0 && g_moved >= 10;
+  printf("edge triggered %d, %d lines received, %d moves, %d errors, %s\n",
+         edgeTriggered, g_received, g_moved.load(), g_errors, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
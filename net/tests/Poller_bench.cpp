@@ -0,0 +1,125 @@
+// Ping-pong over loopback in one loop, once per Poller, each in its own
+// process. Every connection keeps one message in flight, so at high
+// connection counts each iteration handles many channels.
+//
+// poller_bench [connections] [seconds]
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <memory>
+#include <vector>
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 9981;
+const size_t kMessageSize = 64;
+
+int64_t g_messages = 0;
+
+void onEcho(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  g_messages += buf->readableBytes() / kMessageSize;
+  conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->send(string(kMessageSize, 'x'));
+  }
+}
+
+double cpuSeconds()
+{
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+      + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void run(const char* name, uint16_t port, int connections, double seconds)
+{
+  EventLoop loop;
+  InetAddress listenAddr(port, true);
+  TcpServer server(&loop, listenAddr, "PollerBench");
+  server.setMessageCallback(onEcho);
+  server.start();
+  InetAddress serverAddr("127.0.0.1", port);
+
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  for (int i = 0; i < connections; ++i)
+  {
+    clients.emplace_back(new TcpClient(&loop, serverAddr, "PollerBenchClient"));
+    clients.back()->setConnectionCallback(onClientConnection);
+    clients.back()->setMessageCallback(onEcho);
+    clients.back()->connect();
+  }
+
+  int64_t startMessages = 0;
+  int64_t startIteration = 0;
+  double startCpu = 0;
+  // 连接建立之后再开始计时
+  loop.runAfter(0.5, [&] {
+    startMessages = g_messages;
+    startIteration = loop.iteration();
+    startCpu = cpuSeconds();
+  });
+  loop.runAfter(0.5 + seconds, [&] {
+    int64_t messages = g_messages - startMessages;
+    int64_t iterations = loop.iteration() - startIteration;
+    double cpu = cpuSeconds() - startCpu;
+    printf("%-6s %5d connections: %9.0f messages/s, %6.2f messages per iteration, "
+           "%5.2f us cpu per message\n",
+           name, connections, static_cast<double>(messages) / seconds,
+           static_cast<double>(messages) / static_cast<double>(iterations),
+           cpu * 1e6 / static_cast<double>(messages));
+    fflush(stdout);
+    // 直接退出，不用逐个拆除连接
+    _exit(0);
+  });
+  loop.loop();
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  int connections = argc > 1 ? atoi(argv[1]) : 100;
+  double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+  const char* pollers[] = { "epoll", "uring", "poll" };
+  for (int i = 0; i < 3; ++i)
+  {
+    const char* name = pollers[i];
+    pid_t pid = ::fork();
+    if (pid == 0)
+    {
+      if (name[0] == 'u')
+      {
+        ::setenv("MUDUO_USE_URING", "1", 1);
+      }
+      else if (name[0] == 'p')
+      {
+        ::setenv("MUDUO_USE_POLL", "1", 1);
+      }
+      // 上一个进程的连接可能还占着端口
+      run(name, static_cast<uint16_t>(kPort + i), connections, seconds);
+    }
+    ::waitpid(pid, NULL, 0);
+  }
+}
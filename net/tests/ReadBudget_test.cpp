@@ -0,0 +1,189 @@
+// A client writes much more than the read budget of the server connection
+// while the loop is busy, then the server reads it. No loop iteration may read
+// more than the budget, and the rest must be read in the following iterations
+// without new data arriving, level and edge triggered. Then a bulk transfer
+// must grow the read size to 64k, and small messages shrink it back to 1k.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <map>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2027;
+const size_t kBudget = 16 * 1024;
+const size_t kMinReadSize = Buffer::kInitialSize;
+const size_t kMaxReadSize = 64 * 1024;
+const size_t kBulkBytes = 8 * 1024 * 1024;
+
+enum Phase { kBudgeted, kBulk, kSmall, kDone };
+
+struct Result
+{
+  size_t written = 0;
+  size_t received = 0;
+  std::map<int64_t, size_t> bytesPerIteration;
+  size_t peakReadSize = 0;
+  size_t finalReadSize = 0;
+};
+
+int g_client = -1;
+Phase g_phase = kBudgeted;
+Result g_results[kDone];
+int g_smallSent = 0;
+
+// 非阻塞写，写到内核缓冲区满为止
+size_t fill(size_t max)
+{
+  string chunk(64 * 1024, 'x');
+  size_t written = 0;
+  while (written < max)
+  {
+    ssize_t n = ::write(g_client, chunk.data(), std::min(chunk.size(), max - written));
+    if (n <= 0)
+    {
+      break;
+    }
+    written += n;
+  }
+  return written;
+}
+
+void startPhase(const TcpConnectionPtr& conn, Phase phase)
+{
+  g_phase = phase;
+  if (phase == kBudgeted)
+  {
+    conn->setReadBudget(kBudget);
+    g_results[phase].written = fill(32 * kBudget);
+  }
+  else if (phase == kBulk)
+  {
+    conn->setReadBudget(16 * kMaxReadSize);
+    g_results[phase].written = fill(kBulkBytes);
+  }
+  else if (phase == kSmall)
+  {
+    // 一次一个小消息，收到再发下一个
+    g_results[phase].written = fill(10);
+    ++g_smallSent;
+  }
+  else
+  {
+    conn->getLoop()->quit();
+  }
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // 整个写进去之前服务器不会读，loop在这个回调里
+    startPhase(conn, kBudgeted);
+  }
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  Result& r = g_results[g_phase];
+  r.received += buf->readableBytes();
+  r.bytesPerIteration[conn->getLoop()->iteration()] += buf->readableBytes();
+  buf->retrieveAll();
+  r.peakReadSize = std::max(r.peakReadSize, conn->readSize());
+  r.finalReadSize = conn->readSize();
+  if (g_phase == kBulk && r.written < kBulkBytes)
+  {
+    // 客户端的发送缓冲区空出来了，接着写，读满才会加倍
+    r.written += fill(kBulkBytes - r.written);
+  }
+  if (r.received == r.written)
+  {
+    if (g_phase == kSmall && g_smallSent < 30)
+    {
+      r.written += fill(10);
+      ++g_smallSent;
+    }
+    else
+    {
+      conn->getLoop()->queueInLoop(
+          std::bind(startPhase, conn, static_cast<Phase>(g_phase + 1)));
+    }
+  }
+}
+
+bool run(bool edgeTriggered)
+{
+  g_phase = kBudgeted;
+  g_smallSent = 0;
+  for (Result& r : g_results)
+  {
+    r = Result();
+  }
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort), "ReadBudget");
+  server.setEdgeTriggered(edgeTriggered);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+
+  g_client = sockets::createNonblockingOrDie(AF_INET);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::connect(g_client, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+  loop.runAfter(10.0, [&loop] {
+    LOG_ERROR << "timeout";
+    loop.quit();
+  });
+  loop.loop();
+  ::close(g_client);
+
+  const Result& budgeted = g_results[kBudgeted];
+  size_t peak = 0;
+  bool consecutive = true;
+  int64_t last = -1;
+  for (const auto& item : budgeted.bytesPerIteration)
+  {
+    peak = std::max(peak, item.second);
+    if (last >= 0 && item.first != last + 1)
+    {
+      consecutive = false;
+    }
+    last = item.first;
+  }
+  const Result& bulk = g_results[kBulk];
+  const Result& small = g_results[kSmall];
+  bool ok = g_phase == kDone
+    && budgeted.written >= 4 * kBudget && budgeted.received == budgeted.written
+    && peak <= kBudget && consecutive
+    && bulk.peakReadSize == kMaxReadSize
+    && small.finalReadSize == kMinReadSize;
+  printf("edge triggered %d: %zu bytes in %zu iterations, at most %zu per iteration, %s; "
+         "read size up to %zu in bulk, %zu after small messages, %s\n",
+         edgeTriggered, budgeted.received, budgeted.bytesPerIteration.size(), peak,
+         consecutive ? "consecutive" : "NOT consecutive",
+         bulk.peakReadSize, small.finalReadSize, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool ok = run(false);
+  ok = run(true) && ok;
+  return ok ? 0 : 1;
+}
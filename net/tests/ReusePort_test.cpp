@@ -0,0 +1,185 @@
+// An echo server with an acceptor per I/O thread, in both modes. Clients in
+// several threads connect, echo one line and close, a few stay connected
+// while the server is destroyed. Every connection must be served, in the
+// thread which accepted it.
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2025;
+const int kClientThreads = 8;
+const int kConnectsPerThread = 200;
+const int kHeld = 16;
+
+MutexLock g_mutex;
+std::map<EventLoop*, int> g_served;
+AtomicInt32 g_errors;
+AtomicInt32 g_wrongLoop;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    if (!conn->getLoop()->isInLoopThread())
+    {
+      g_wrongLoop.increment();
+    }
+    MutexLockGuard lock(g_mutex);
+    ++g_served[conn->getLoop()];
+  }
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+int connectServer()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool echoOnce(int fd)
+{
+  const char msg[] = "hello\n";
+  char buf[sizeof msg];
+  if (::write(fd, msg, sizeof msg - 1) != sizeof msg - 1)
+  {
+    return false;
+  }
+  size_t n = 0;
+  while (n < sizeof msg - 1)
+  {
+    ssize_t nr = ::read(fd, buf + n, sizeof msg - 1 - n);
+    if (nr <= 0)
+    {
+      return false;
+    }
+    n += nr;
+  }
+  return memcmp(buf, msg, sizeof msg - 1) == 0;
+}
+
+void clientThread()
+{
+  for (int i = 0; i < kConnectsPerThread; ++i)
+  {
+    int fd = connectServer();
+    if (fd < 0 || !echoOnce(fd))
+    {
+      g_errors.increment();
+    }
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+  }
+}
+
+bool run(TcpServer::AcceptMode mode, const char* name)
+{
+  g_served.clear();
+  g_errors.getAndSet(0);
+  g_wrongLoop.getAndSet(0);
+  std::vector<int> held;
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ReusePortServer", TcpServer::kReusePort);
+    server.setThreadNum(3);
+    server.setAcceptMode(mode);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    Thread clients([&loop, &held] {
+      std::vector<std::unique_ptr<Thread>> threads;
+      for (int i = 0; i < kClientThreads; ++i)
+      {
+        threads.emplace_back(new Thread(clientThread));
+        threads.back()->start();
+      }
+      for (auto& t : threads)
+      {
+        t->join();
+      }
+      // 这些连接在服务器析构时还开着
+      for (int i = 0; i < kHeld; ++i)
+      {
+        int fd = connectServer();
+        if (fd < 0 || !echoOnce(fd))
+        {
+          g_errors.increment();
+        }
+        held.push_back(fd);
+      }
+      loop.quit();
+    });
+    // 等监听socket都建好
+    loop.runAfter(0.2, [&clients] { clients.start(); });
+    loop.loop();
+    clients.join();
+  }
+
+  int total = 0;
+  printf("%s:", name);
+  for (const auto& item : g_served)
+  {
+    printf(" %d", item.second);
+    total += item.second;
+  }
+  // 服务器关闭了留着的连接
+  int closed = 0;
+  for (int fd : held)
+  {
+    char c;
+    if (fd >= 0 && ::read(fd, &c, 1) == 0)
+    {
+      ++closed;
+    }
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+  }
+  const int expected = kClientThreads * kConnectsPerThread + kHeld;
+  bool ok = total == expected && g_errors.get() == 0 && g_wrongLoop.get() == 0
+    && closed == kHeld && g_served.size() >= 2;
+  printf(", %d connections, %d errors, %d held closed, %s\n",
+         total, g_errors.get(), closed, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool ok = run(TcpServer::kReusePortPerLoop, "SO_REUSEPORT");
+  ok = run(TcpServer::kExclusivePerLoop, "EPOLLEXCLUSIVE") && ok;
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// Request timeouts added from another thread, most of them canceled before
+// they expire, as on a busy server. Runs with and without slack, with the
+// timerfd and with the poll timeout, and counts how often the wakeup is set.
+// A timer must never run early, nor much later than its slack.
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#include <atomic>
+#include <random>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kTimers = 3000;
+const double kLateTolerance = 0.05;
+
+std::atomic<int> g_fired;
+std::atomic<int> g_early;
+std::atomic<int> g_late;
+
+void onTimeout(Timestamp expiration, double slack)
+{
+  double late = timeDifference(Timestamp::now(), expiration);
+  if (late < 0)
+  {
+    ++g_early;
+  }
+  else if (late > slack + kLateTolerance)
+  {
+    ++g_late;
+  }
+  ++g_fired;
+}
+
+int64_t run(bool useTimerfd, double slack)
+{
+  g_fired = 0;
+  g_early = 0;
+  g_late = 0;
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  loop->runInLoop([loop, useTimerfd] { loop->setUseTimerfd(useTimerfd); });
+  const int64_t arms = loop->timerArms();
+
+  std::mt19937 rng(2024);
+  int canceled = 0;
+  for (int i = 0; i < kTimers; ++i)
+  {
+    double delay = 0.05 + (rng() % 100) / 1000.0;
+    Timestamp expiration = addTime(Timestamp::now(), delay);
+    TimerId id = loop->runAt(expiration, std::bind(onTimeout, expiration, slack), slack);
+    // 大部分请求在超时之前完成
+    if (rng() % 4 != 0)
+    {
+      loop->cancel(id);
+      ++canceled;
+    }
+    usleep(100);
+  }
+  while (g_fired + canceled < kTimers)
+  {
+    usleep(10 * 1000);
+  }
+  // 已经取消的定时器可能还要唤醒一次
+  usleep(200 * 1000);
+  int64_t n = loop->timerArms() - arms;
+  printf("timerfd %d, slack %.3f: %d fired, %d early, %d late, wakeup set %lld times\n",
+         useTimerfd, slack, g_fired.load(), g_early.load(), g_late.load(),
+         static_cast<long long>(n));
+  return n;
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  bool ok = true;
+  for (int useTimerfd = 1; useTimerfd >= 0; --useTimerfd)
+  {
+    int64_t exact = run(useTimerfd, 0.0);
+    ok = ok && g_early == 0 && g_late == 0;
+    int64_t coalesced = run(useTimerfd, 0.02);
+    ok = ok && g_early == 0 && g_late == 0 && coalesced < exact;
+  }
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
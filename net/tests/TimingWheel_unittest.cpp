@@ -0,0 +1,177 @@
+#include "muduo/net/TimingWheel.h"
+#include "muduo/net/Timer.h"
+
+//#define BOOST_TEST_MODULE TimingWheelTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <random>
+
+using muduo::Timestamp;
+using muduo::net::Timer;
+using muduo::net::TimingWheel;
+
+namespace
+{
+
+// 用expiration保存tick，方便检查
+void setTick(Timer* timer, int64_t tick)
+{
+  timer->set(muduo::net::TimerCallback(), Timestamp(tick), 0.0, 0.0);
+}
+
+int64_t tickOf(const Timer* timer)
+{
+  return timer->expiration().microSecondsSinceEpoch();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testOrder)
+{
+  TimingWheel wheel(0);
+  Timer timers[3];
+  setTick(&timers[0], 5);
+  setTick(&timers[1], 1);
+  setTick(&timers[2], 3);
+  for (Timer& t : timers)
+  {
+    wheel.add(&t, tickOf(&t));
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 3);
+  BOOST_CHECK_EQUAL(wheel.nextTick(), 1);
+
+  std::vector<Timer*> expired;
+  wheel.advance(0, &expired);
+  BOOST_CHECK(expired.empty());
+  wheel.advance(10, &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 3);
+  BOOST_CHECK_EQUAL(expired[0], &timers[1]);
+  BOOST_CHECK_EQUAL(expired[1], &timers[2]);
+  BOOST_CHECK_EQUAL(expired[2], &timers[0]);
+  BOOST_CHECK_EQUAL(wheel.size(), 0);
+  BOOST_CHECK_EQUAL(wheel.nextTick(), -1);
+  for (Timer& t : timers)
+  {
+    BOOST_CHECK(!wheel.contains(&t));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testPastDue)
+{
+  TimingWheel wheel(1000);
+  Timer timer;
+  setTick(&timer, 10);
+  wheel.add(&timer, tickOf(&timer));
+  BOOST_CHECK_EQUAL(wheel.nextTick(), 1000);
+  std::vector<Timer*> expired;
+  wheel.advance(999, &expired);
+  BOOST_CHECK(expired.empty());
+  wheel.advance(1000, &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 1);
+  BOOST_CHECK_EQUAL(expired[0], &timer);
+}
+
+BOOST_AUTO_TEST_CASE(testRemove)
+{
+  TimingWheel wheel(0);
+  Timer timers[4];
+  const int64_t ticks[] = { 7, 7, 300, 70000 };
+  for (int i = 0; i < 4; ++i)
+  {
+    setTick(&timers[i], ticks[i]);
+    wheel.add(&timers[i], ticks[i]);
+    BOOST_CHECK(wheel.contains(&timers[i]));
+  }
+  wheel.remove(&timers[0]);
+  wheel.remove(&timers[3]);
+  BOOST_CHECK(!wheel.contains(&timers[0]));
+  BOOST_CHECK(!wheel.contains(&timers[3]));
+  BOOST_CHECK_EQUAL(wheel.size(), 2);
+
+  std::vector<Timer*> expired;
+  wheel.advance(100000, &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 2);
+  BOOST_CHECK_EQUAL(expired[0], &timers[1]);
+  BOOST_CHECK_EQUAL(expired[1], &timers[2]);
+}
+
+BOOST_AUTO_TEST_CASE(testFarAway)
+{
+  // 超出时间轮的范围
+  const int64_t start = 123456789;
+  const int64_t far = start + (static_cast<int64_t>(1) << 34) + 17;
+  TimingWheel wheel(start);
+  Timer timer;
+  setTick(&timer, far);
+  wheel.add(&timer, far);
+
+  std::vector<Timer*> expired;
+  int64_t tick = start;
+  int wakeups = 0;
+  while (expired.empty())
+  {
+    tick = wheel.nextTick();
+    BOOST_REQUIRE(tick > 0 && tick <= far);
+    wheel.advance(tick, &expired);
+    ++wakeups;
+  }
+  BOOST_CHECK_EQUAL(tick, far);
+  BOOST_CHECK_EQUAL(expired[0], &timer);
+  BOOST_CHECK_LT(wakeups, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testRandom)
+{
+  const int kTimers = 10000;
+  std::mt19937_64 rng(20);
+  int64_t now = 987654321;
+  TimingWheel wheel(now + 1);
+  std::vector<Timer> timers(kTimers);
+  for (Timer& t : timers)
+  {
+    // 大部分近，少数远
+    int64_t delta = static_cast<int64_t>(rng() % (static_cast<uint64_t>(1) << (rng() % 30)));
+    setTick(&t, now + 1 + delta);
+    wheel.add(&t, tickOf(&t));
+  }
+
+  size_t total = 0;
+  std::vector<Timer*> expired;
+  while (wheel.size() > 0)
+  {
+    // 不能晚于最早的定时器
+    int64_t next = wheel.nextTick();
+    BOOST_REQUIRE_GT(next, now);
+    int64_t step = next - now;
+    if (rng() % 2)
+    {
+      step = 1 + static_cast<int64_t>(rng() % static_cast<uint64_t>(step * 2));
+    }
+    int64_t tick = now + step;
+    wheel.advance(tick, &expired);
+    if (tick < next)
+    {
+      BOOST_REQUIRE(expired.empty());
+    }
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+      BOOST_REQUIRE_GT(tickOf(expired[i]), now);
+      BOOST_REQUIRE_LE(tickOf(expired[i]), tick);
+      if (i > 0)
+      {
+        BOOST_REQUIRE_LE(tickOf(expired[i - 1]), tickOf(expired[i]));
+      }
+    }
+    total += expired.size();
+    expired.clear();
+    now = tick;
+  }
+  BOOST_CHECK_EQUAL(total, kTimers);
+  for (const Timer& t : timers)
+  {
+    BOOST_CHECK_LE(tickOf(&t), now);
+  }
+}
@@ -0,0 +1,104 @@
+// MSG_ZEROCOPY over loopback: the server sends large Payloads with zero copy,
+// the client checks every byte, then the server waits for all completions.
+// On loopback the kernel copies after all, but the protocol is the same.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kFrames = 200;
+const size_t kFrameSize = 512 * 1024;
+
+char frameByte(size_t offset)
+{
+  return static_cast<char>((offset / kFrameSize * 31 + offset) % 251);
+}
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    return;
+  }
+  if (!conn->setZeroCopy(true))
+  {
+    LOG_ERROR << "SO_ZEROCOPY not supported";
+    conn->shutdown();
+    return;
+  }
+  for (int i = 0; i < kFrames; ++i)
+  {
+    string frame(kFrameSize, '\0');
+    for (size_t j = 0; j < kFrameSize; ++j)
+    {
+      frame[j] = frameByte(i * kFrameSize + j);
+    }
+    // the frame is freed when the last reference goes, after the completion
+    conn->send(Payload(std::move(frame)));
+  }
+}
+
+void onServerWriteComplete(const TcpConnectionPtr& conn)
+{
+  BufferChain* output = conn->outputBuffer();
+  LOG_INFO << "pending zero copy sends " << output->numZeroCopyPending()
+           << ", copied by kernel " << output->numZeroCopyCopied();
+  if (output->empty())
+  {
+    conn->shutdown();
+  }
+}
+
+size_t g_received = 0;
+bool g_ok = true;
+
+void onClientMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  const char* data = buf->peek();
+  for (size_t i = 0; i < buf->readableBytes(); ++i)
+  {
+    if (data[i] != frameByte(g_received + i))
+    {
+      g_ok = false;
+    }
+  }
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+int main()
+{
+  // server and client share one loop
+  EventLoop loop;
+  InetAddress listenAddr(2020);
+  TcpServer server(&loop, listenAddr, "ZeroCopyServer");
+  server.setConnectionCallback(onServerConnection);
+  server.setWriteCompleteCallback(onServerWriteComplete);
+  server.start();
+
+  InetAddress serverAddr("127.0.0.1", 2020);
+  TcpClient client(&loop, serverAddr, "ZeroCopyClient");
+  client.setMessageCallback(onClientMessage);
+  client.setConnectionCallback(
+      [&loop](const TcpConnectionPtr& conn)
+      {
+        if (!conn->connected())
+        {
+          // let the server side close too
+          loop.runAfter(0.5, std::bind(&EventLoop::quit, &loop));
+        }
+      });
+  client.connect();
+  loop.loop();
+
+  bool ok = g_ok && g_received == kFrames * kFrameSize;
+  printf("received %zu of %zu bytes, %s\n", g_received, kFrames * kFrameSize,
+         ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}